@@ -0,0 +1,133 @@
+#ifndef _APPEND_ONLY_VECTOR_H
+#define _APPEND_ONLY_VECTOR_H
+
+#include <atomic>
+#include <vector>
+#include "common.h"
+
+// Vector of immutable elements which can be read concurrently without locks
+// while other thread is appending elements or replacing them.
+// Elements are stored in segments whose size doubles each time, so appending
+// never moves existing elements. An element is published by increasing the
+// size after it has been written, so readers only see fully constructed
+// elements. Replaced elements are kept alive until the vector is destroyed or
+// cleared, as readers may still be using them.
+// Writes (push_back, replace and clear) must be serialized by the caller.
+template <class T>
+class AppendOnlyVector {
+public:
+	AppendOnlyVector();
+	~AppendOnlyVector();
+
+	AppendOnlyVector(const AppendOnlyVector&) = delete;
+	AppendOnlyVector& operator=(const AppendOnlyVector&) = delete;
+
+	size_t size() const;
+	bool empty() const;
+	const T& operator[](size_t i) const;
+
+	// Append an element and return its index
+	size_t push_back(const T& value);
+
+	// Replace element at index `i`
+	void replace(size_t i, const T& value);
+
+	// Remove every element. This is not thread safe, and it must not be
+	// called while other threads may be reading.
+	void clear();
+
+private:
+	// Segment i has FIRST_SEGMENT_SIZE << i elements
+	static const size_t FIRST_SEGMENT_BITS = 10;
+	static const size_t FIRST_SEGMENT_SIZE = 1 << FIRST_SEGMENT_BITS;
+	static const size_t MAX_SEGMENTS = 40;
+
+	std::atomic<const T*>* m_segments[MAX_SEGMENTS];
+	std::atomic<size_t> m_size;
+
+	// Elements that have been replaced
+	std::vector<const T*> m_retired;
+
+	std::atomic<const T*>& slot(size_t i) const;
+};
+
+template <class T>
+AppendOnlyVector<T>::AppendOnlyVector()
+	: m_segments{}
+	, m_size(0)
+{
+}
+
+template <class T>
+AppendOnlyVector<T>::~AppendOnlyVector() {
+	clear();
+}
+
+template <class T>
+size_t AppendOnlyVector<T>::size() const {
+	return m_size.load(std::memory_order_acquire);
+}
+
+template <class T>
+bool AppendOnlyVector<T>::empty() const {
+	return size() == 0;
+}
+
+template <class T>
+std::atomic<const T*>& AppendOnlyVector<T>::slot(size_t i) const {
+	// Segment of element i is given by the most significant bit of
+	// i + FIRST_SEGMENT_SIZE
+	size_t n = i + FIRST_SEGMENT_SIZE;
+	size_t msb = 63 - __builtin_clzl(n);
+	size_t segment = msb - FIRST_SEGMENT_BITS;
+	return m_segments[segment][n - (1UL << msb)];
+}
+
+template <class T>
+const T& AppendOnlyVector<T>::operator[](size_t i) const {
+	ASSERT(i < size(), "OOB i: %lu/%lu", i, size());
+	return *slot(i).load(std::memory_order_acquire);
+}
+
+template <class T>
+size_t AppendOnlyVector<T>::push_back(const T& value) {
+	size_t i = m_size.load(std::memory_order_relaxed);
+
+	// Allocate segment if needed. Readers can't access it until we increase
+	// the size.
+	size_t n = i + FIRST_SEGMENT_SIZE;
+	size_t msb = 63 - __builtin_clzl(n);
+	size_t segment = msb - FIRST_SEGMENT_BITS;
+	ASSERT(segment < MAX_SEGMENTS, "too many elements: %lu", i);
+	if (!m_segments[segment])
+		m_segments[segment] = new std::atomic<const T*>[1UL << msb];
+
+	// Write element and publish it
+	slot(i).store(new T(value), std::memory_order_relaxed);
+	m_size.store(i + 1, std::memory_order_release);
+	return i;
+}
+
+template <class T>
+void AppendOnlyVector<T>::replace(size_t i, const T& value) {
+	ASSERT(i < size(), "OOB i: %lu/%lu", i, size());
+	const T* old = slot(i).exchange(new T(value), std::memory_order_acq_rel);
+	m_retired.push_back(old);
+}
+
+template <class T>
+void AppendOnlyVector<T>::clear() {
+	size_t n = size();
+	for (size_t i = 0; i < n; i++)
+		delete slot(i).load(std::memory_order_relaxed);
+	for (const T* p : m_retired)
+		delete p;
+	m_retired.clear();
+	for (size_t i = 0; i < MAX_SEGMENTS; i++) {
+		delete[] m_segments[i];
+		m_segments[i] = nullptr;
+	}
+	m_size.store(0, std::memory_order_release);
+}
+
+#endif
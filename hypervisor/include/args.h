@@ -3,11 +3,18 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
+#include "scheduler.h"
 
 struct Args {
 	int jobs;
 	size_t memory;
 	size_t timeout;
+	size_t snapshot_cache;
+	size_t stats_interval;
+	uint64_t sample_interval;
+	uint64_t seed;
+	Scheduler::Schedule schedule;
 	std::string kernel_path;
 	std::string input_dir;
 	std::string output_dir;
@@ -19,6 +26,7 @@ struct Args {
 	std::string single_run_input_path;
 	bool minimize_corpus;
 	bool minimize_crashes;
+	bool no_trim;
 
 	bool parse(int argc, char** argv);
 };
@@ -0,0 +1,72 @@
+#ifndef _ASYNC_WRITER_H
+#define _ASYNC_WRITER_H
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include "common.h"
+#include "input_storage.h"
+
+// Performs output of the fuzzer in a dedicated thread, so workers never wait
+// for the filesystem. Requests are pushed to a lock-free multiple producer
+// single consumer queue, and the writer thread performs them in the order they
+// were pushed, in batches. The filesystem is synced periodically.
+class AsyncWriter {
+public:
+	// Time the writer thread sleeps when there are no requests, and minimum
+	// time between syncs
+	static const int IDLE_TIME_MS = 10;
+	static const int SYNC_TIME_MS = 5000;
+
+	// Files will be written to the filesystem `dir` is in
+	AsyncWriter(const std::string& dir);
+
+	// Wait for every request to be performed
+	~AsyncWriter();
+
+	AsyncWriter(const AsyncWriter&) = delete;
+	AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+	// Write data to a file, replacing it. Data is copied, except for stored
+	// inputs, which never move.
+	void write_file(const std::string& path, const std::string& data);
+	void write_file(const std::string& path, const InputRef& input);
+
+	// Run `task` in the writer thread after the requests pushed before it.
+	// Used for output that isn't a whole file, such as appending to a pack or
+	// printing crashes.
+	void run(const std::function<void()>& task);
+
+	// Wait until every request pushed so far has been performed
+	void flush();
+
+private:
+	struct Request {
+		std::atomic<Request*> next;
+		std::string path;
+		std::string owned_data;
+		InputRef data;
+		std::function<void()> task;
+	};
+
+	// Queue. Producers push to the tail, and the writer thread pops from the
+	// head, which is a request that has already been performed
+	std::atomic<Request*> m_tail;
+	Request* m_head;
+
+	// Number of requests pushed and performed
+	std::atomic<size_t> m_pushed;
+	std::atomic<size_t> m_done;
+
+	int m_dir_fd;
+	std::atomic<bool> m_stop;
+	std::thread m_thread;
+
+	void push(Request* request);
+	Request* pop();
+	void perform(Request& request);
+	void writer_thread();
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef _BLOOM_FILTER_H
+#define _BLOOM_FILTER_H
+
+#include <vector>
+#include <algorithm>
+#include "common.h"
+
+// Bloom filter of 64-bit hashes which forgets old elements. It has two
+// generations of bits: elements are inserted in the current one, and checked
+// against both. When the current generation is full, it becomes the previous
+// one and the oldest bits are cleared, so the false positive rate stays low
+// no matter how many elements are inserted.
+class DecayingBloomFilter {
+public:
+	// Number of bits set per element
+	static const size_t NUM_HASHES = 4;
+
+	// Bits per element in each generation. With 4 hashes this gives a false
+	// positive rate of about 0.24% per generation.
+	static const size_t BITS_PER_ELEMENT = 16;
+
+	// Create a filter that remembers at least the last `capacity` elements
+	DecayingBloomFilter(size_t capacity);
+
+	// Insert `hash` and return whether it was already there
+	bool insert(uint64_t hash);
+
+	void clear();
+
+private:
+	size_t m_capacity;
+	size_t m_size;
+	size_t m_mask;
+	std::vector<uint64_t> m_current;
+	std::vector<uint64_t> m_previous;
+
+	static bool test(const std::vector<uint64_t>& bits, size_t i);
+};
+
+inline DecayingBloomFilter::DecayingBloomFilter(size_t capacity)
+	: m_capacity(capacity)
+	, m_size(0)
+{
+	// Round number of bits to a power of two, so we can mask instead of mod
+	size_t num_bits = 64;
+	while (num_bits < capacity * BITS_PER_ELEMENT)
+		num_bits *= 2;
+	m_mask = num_bits - 1;
+	m_current.resize(num_bits / 64);
+	m_previous.resize(num_bits / 64);
+}
+
+inline bool DecayingBloomFilter::test(const std::vector<uint64_t>& bits,
+                                      size_t i)
+{
+	return bits[i / 64] & (1ULL << (i % 64));
+}
+
+inline bool DecayingBloomFilter::insert(uint64_t hash) {
+	// Derive the bit indexes from the two halves of the hash, as in
+	// Kirsch-Mitzenmacher double hashing
+	uint64_t h1 = hash & 0xFFFFFFFF, h2 = (hash >> 32) | 1;
+	bool in_current = true, in_previous = true;
+	size_t i;
+	for (size_t k = 0; k < NUM_HASHES; k++) {
+		i = (h1 + k*h2) & m_mask;
+		in_current  &= test(m_current, i);
+		in_previous &= test(m_previous, i);
+	}
+	if (in_current)
+		return true;
+
+	// Start a new generation if this one is full
+	if (m_size == m_capacity) {
+		m_current.swap(m_previous);
+		std::fill(m_current.begin(), m_current.end(), 0);
+		m_size = 0;
+	}
+	for (size_t k = 0; k < NUM_HASHES; k++) {
+		i = (h1 + k*h2) & m_mask;
+		m_current[i / 64] |= 1ULL << (i % 64);
+	}
+	m_size++;
+	return in_previous;
+}
+
+inline void DecayingBloomFilter::clear() {
+	std::fill(m_current.begin(), m_current.end(), 0);
+	std::fill(m_previous.begin(), m_previous.end(), 0);
+	m_size = 0;
+}
+
+#endif
@@ -1,90 +1,126 @@
 #include <vector>
 #include <set>
 #include <unordered_set>
+#include <unordered_map>
 #include <string>
 #include <atomic>
+#include <memory>
 #include <stats.h>
 #include "common.h"
 #include "fault.h"
 #include "coverage.h"
-
-// Used for mutating inputs. We don't use glibc rand() because it uses locks
-// in order to be thread safe. Instead, we implement a simpler algorithm, and
-// each thread will have its own rng.
-class Rng {
-	private:
-		uint64_t x_state;
-		uint64_t y_state;
-		uint64_t z_state;
-
-		inline uint64_t rotl(uint64_t n, unsigned int rot) {
-			return (n << rot) | (n >> (8*sizeof(n) - rot));
-		}
-
-	public:
-		Rng(){
-			x_state = _rdtsc();
-			y_state = _rdtsc();
-			z_state = _rdtsc();
-		}
-
-		inline uint64_t rnd(){
-			// RomuTrio
-			uint64_t xp = x_state, yp = y_state, zp = z_state;
-			x_state = 15241094284759029579u * zp;
-			y_state = yp - xp;  y_state = rotl(y_state, 12);
-			z_state = zp - yp;  z_state = rotl(z_state, 44);
-			return xp;
-		}
-
-		inline uint64_t rnd(uint64_t min, uint64_t max){
-			ASSERT(max >= min, "rnd bad range: %lu, %lu", min, max);
-			return min + (rnd() % (max-min+1));
-		}
-
-		inline uint64_t rnd_exp(uint64_t min, uint64_t max){
-			uint64_t x = rnd(min, max);
-			return rnd(min, x);
-		}
-};
-
+#include "input_read_info.h"
+#include "append_only_vector.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "bloom_filter.h"
+#include "input_storage.h"
+#include "pack_file.h"
+#include "async_writer.h"
 
 class Corpus {
 public:
 	static const int MIN_MUTATIONS = 1;
 	static const int MAX_MUTATIONS = 10;
+
+	// Number of recent inputs each thread remembers for discarding duplicated
+	// mutated inputs, and times an input is mutated again when it's a
+	// duplicate before giving up
+	static const size_t SEEN_INPUTS_CAPACITY = 64*1024;
+	static const int MAX_DUP_RETRIES = 8;
 	static constexpr const char* CORPUS_DIR      = "corpus";
 	static constexpr const char* CRASHES_DIR     = "crashes";
 	static constexpr const char* MIN_CORPUS_DIR  = "minimized_corpus";
 	static constexpr const char* MIN_CRASHES_DIR = "minimized_crashes";
+	static constexpr const char* PACK_FILE       = "corpus_pack";
+	static constexpr const char* CHECKPOINT_FILE = "coverage_checkpoint";
+
+	// Element of the corpus: an input and the parts of it that were read by
+	// the target, which mutations focus on. Elements are never modified once
+	// they are in the corpus.
+	struct Entry {
+		InputRef data;
+		InputReadInfo read_info;
+	};
 
-	Corpus(int nthreads, const std::string& input, const std::string& output);
+	// If input dir is "-", the corpus of a previous campaign with the same
+	// output dir is used. If that campaign left a pack, inputs are read from
+	// it instead of from the corpus dir, and the campaign can be resumed.
+	Corpus(int nthreads, const std::string& input, const std::string& output,
+	       Scheduler::Schedule schedule);
 
 	// Trivial getters
 	size_t size() const;
 	size_t memsize() const;
 	size_t max_input_size() const;
 	size_t unique_crashes() const;
+	size_t crash_buckets() const;
 	size_t coverage() const;
+	size_t favored() const;
 	std::string seed_filename(size_t i) const;
-	const std::string& element(size_t i) const;
+	InputRef element(size_t i) const;
+	const Entry& entry(size_t i) const;
+
+	// Whether the corpus was read from the pack of a previous campaign
+	bool resumed() const;
 
 	// Set mode. This must be called before doing anything else. Normal mode
-	// requires the total coverage of the seed corpus, while minimization
-	// modes require the coverage or fault associated to each seed input.
-	void set_mode_normal(const Coverage& total_coverage);
+	// requires the coverage of each seed input, the parts of it that were
+	// read and its execution cost, while minimization modes require the
+	// coverage or fault associated to each seed input. A resumed corpus
+	// already has those for normal mode, which is set with
+	// `set_mode_normal_resumed` without running the inputs again.
+	void set_mode_normal(const std::vector<Coverage>& coverages,
+	                     const std::vector<InputReadInfo>& read_infos,
+	                     const std::vector<ExecInfo>& exec_infos);
+	void set_mode_normal_resumed();
 	void set_mode_corpus_min(const std::vector<Coverage>& coverages);
 	void set_mode_crashes_min(const std::vector<FaultInfo>& faults);
 
 	// Get a new mutated input, which will be a constant reference to
-	// `mutated_inputs[id]`
+	// `mutated_inputs[id]`. Inputs that were recently generated by the same
+	// thread are mutated again, and counted as `stats.dup_inputs`.
 	const std::string& get_new_input(int id, Rng& rng, Stats& stats);
 
-	// Report a new crash
-	void report_crash(int id, const FaultInfo& fault);
-
-	// Report coverage of a run
-	void report_coverage(int id, const Coverage& cov);
+	// Index of the corpus element `mutated_inputs[id]` was mutated from
+	size_t mutated_input_index(int id) const;
+
+	// Offset of the first byte of `mutated_inputs[id]` that differs from the
+	// corpus element it was mutated from
+	size_t mutated_input_offset(int id);
+
+	// Report a new crash, along with the fingerprint of the coverage of the
+	// run. Crashes are bucketed by fault and path, and an input is saved for
+	// each bucket. If the coverage doesn't have the whole path of a run (see
+	// Coverage::HAS_PATHS), path must be 0 and crashes are bucketed by fault.
+	void report_crash(int id, const FaultInfo& fault, uint64_t path);
+
+	// Report coverage of a run. In normal mode, return whether there was new
+	// coverage, in which case the input should be added to the corpus with
+	// `add_new_input`. Coverage with a path this thread has recently reported
+	// is not merged, as it can't have anything new.
+	bool report_coverage(int id, const Coverage& cov);
+
+	// Add an input with new coverage, which may have been trimmed from
+	// `mutated_inputs[id]`, along with its coverage, the parts of it that
+	// were read by the target and its execution cost.
+	void add_new_input(int id, const std::string& input, const Coverage& cov,
+	                   const InputReadInfo& read_info,
+	                   const ExecInfo& exec_info);
+
+	// Replace corpus element `i` with its minimized version, found by the
+	// CrashMinimizer in crashes minimization mode, and write it to disk
+	void set_minimized_crash(size_t i, const std::string& input);
+
+	// Cull the corpus and recalculate the scores used for choosing which
+	// inputs are mutated. This is expected to be called periodically from a
+	// background thread.
+	void update_schedule();
+
+	// Write the recorded coverage to disk, so a resumed campaign doesn't
+	// have to merge the coverage of every input in the pack. This is
+	// expected to be called periodically from a background thread.
+	void checkpoint();
 
 private:
 	enum Mode {
@@ -100,21 +136,57 @@ private:
 	std::string m_output_dir_crashes;
 	std::string m_output_dir_min_corpus;
 	std::string m_output_dir_min_crashes;
+	std::string m_pack_path;
+	std::string m_checkpoint_path;
 
-	// Corpus and its lock
-	std::vector<std::string> m_corpus;
+	// Corpus, the storage of its inputs, and the lock for writing to them.
+	// Reading the corpus doesn't need locking.
+	AppendOnlyVector<Entry> m_corpus;
+	InputStorage m_storage;
 	std::atomic_flag m_lock_corpus;
 
-	// Unique crashes and its lock
-	std::unordered_set<FaultInfo> m_crashes;
+	// Pack where inputs are appended in normal mode, protected by
+	// `m_lock_corpus`. If the corpus was resumed, inputs that were in it are
+	// mapped and referenced by `m_storage`.
+	std::unique_ptr<PackFile> m_pack;
+	bool m_resumed;
+
+	// Unique crashes with the paths that led to each of them, the number of
+	// buckets, and the lock
+	std::unordered_map<FaultInfo, std::unordered_set<uint64_t>> m_crashes;
+	std::atomic<size_t> m_crash_buckets;
 	std::atomic_flag m_lock_crashes;
 
-	// Vector with one mutated input for each thread. No need to lock
+	// Paths of the inputs in the corpus, protected by `m_lock_corpus`. Inputs
+	// with the same path as another one are not added.
+	std::unordered_set<uint64_t> m_corpus_paths;
+
+	// Paths each thread has recently reported, in a direct-mapped table
+	// indexed by the low bits of the path. A path is forgotten when another
+	// one takes its slot, which only costs a merge. No need to lock
+	static const size_t SEEN_PATHS_SIZE = 64*1024;
+	std::vector<std::vector<uint64_t>> m_seen_paths;
+
+	// Vector with one mutated input for each thread, and the read info of
+	// the element it was mutated from. No need to lock. Mutated inputs have
+	// capacity for `m_max_input_size` bytes, so mutating them doesn't
+	// allocate memory
 	std::vector<std::string> m_mutated_inputs;
+	std::vector<InputReadInfo> m_mutated_inputs_read_infos;
+
+	// Filter of hashes of recent mutated inputs for each thread
+	std::vector<DecayingBloomFilter> m_seen_inputs;
 
 	// Recorded coverage in all runs
 	SharedCoverage m_recorded_coverage;
 
+	// Coverage of the entries appended to the pack, which is what checkpoints
+	// save. Only the writer thread accesses it once the mode is set.
+	Coverage m_pack_coverage;
+
+	// Scheduler used in normal mode for choosing inputs to mutate
+	Scheduler m_scheduler;
+
 	// Max input size, used in expand mutation
 	size_t m_max_input_size;
 
@@ -131,20 +203,38 @@ private:
 	// Coverage of each of the seeds, when in mode CorpusMinimization
 	std::vector<Coverage> m_coverages;
 
-	// Fault of each of the seeds, when in mode FaultMinimization
-	std::vector<FaultInfo> m_faults;
+	// Writer of every file, so workers don't wait for the filesystem. It is
+	// declared last so it's destroyed first, performing pending requests
+	// while the members they use, such as the storage, the pack and its
+	// coverage, are still alive.
+	std::unique_ptr<AsyncWriter> m_writer;
+
 
+	// Read initial corpus from input dir or from the pack
+	void read_input_dir();
+	void read_pack();
 
-	// Add input to corpus and write it to corpus dir
-	void add_input(const std::string& new_input);
+	// Read the coverage checkpoint into the coverage of the pack, and return
+	// the number of entries of the pack whose coverage it includes
+	size_t read_checkpoint();
+
+	// Replace the whole corpus with `entries`. Used when setting mode, before
+	// any thread is reading the corpus.
+	void set_corpus(const std::vector<Entry>& entries);
+
+	// Add input to corpus, register it in the scheduler and write it to
+	// corpus dir. The part of the input that was never read is removed,
+	// unless the target observed its size.
+	void add_input(const std::string& new_input,
+	               const InputReadInfo& read_info, const ExecInfo& exec_info,
+	               size_t depth, const Coverage& cov);
 
 	// Mutate input in `mutated_inputs[id]`
 	void mutate_input(int id, Rng& rng);
 
-	// Check if last mutation reduced the file size while keeping the fault/cov
+	// Check if last mutation reduced the file size while keeping the coverage
 	// the same. In that case, replace associated input in the corpus with
 	// the reduced one, and write it to its corresponding dir.
-	void handle_crash_crashes_minimization(int id, const FaultInfo& fault);
 	void handle_cov_corpus_minimization(int id, const Coverage& cov);
 
 	// Apply afl-cmin algorithm to reduce number of elements in the corpus
@@ -159,36 +249,13 @@ private:
 
 	// Write `m_corpus[i]` to corresponding output directory. Crash files option
 	// is overloaded so we can get it from `m_mutated_inputs[id]` in case we
-	// decide not to add crash files to corpus.
+	// decide not to add crash files to corpus. Crash files of a fault other
+	// than the first one have the path in their name. Files are written
+	// asynchronously by `m_writer`.
 	void write_corpus_file(size_t i);
-	void write_crash_file(int id, const FaultInfo& fault);
+	void write_crash_file(int id, const FaultInfo& fault, uint64_t path,
+	                      bool first_path);
 	void write_crash_file(size_t i, const FaultInfo& fault);
 	void write_min_corpus_file(size_t i);
 	void write_min_crash_file(size_t i);
-
-	// Mutation strategies
-	typedef void (Corpus::*mutation_strat_t)(std::string& input, Rng& rng);
-	static const std::vector<mutation_strat_t> mut_strats;
-	static const std::vector<mutation_strat_t> mut_strats_reduce;
-	void mut_shrink(std::string& input, Rng& rng);
-	void mut_expand(std::string& input, Rng& rng);
-	void mut_bit(std::string& input, Rng& rng);
-	void mut_dec_byte(std::string& input, Rng& rng);
-	void mut_inc_byte(std::string& input, Rng& rng);
-	void mut_neg_byte(std::string& input, Rng& rng);
-	void mut_add_sub(std::string& input, Rng& rng);
-	void mut_set(std::string& input, Rng& rng);
-	void mut_swap(std::string& input, Rng& rng);
-	void mut_copy(std::string& input, Rng& rng);
-	void mut_inter_splice(std::string& input, Rng& rng);
-	void mut_insert_rand(std::string& input, Rng& rng);
-	void mut_overwrite_rand(std::string& input, Rng& rng);
-	void mut_byte_repeat_overwrite(std::string& input, Rng& rng);
-	void mut_byte_repeat_insert(std::string& input, Rng& rng);
-	void mut_magic_overwrite(std::string& input, Rng& rng);
-	void mut_magic_insert(std::string& input, Rng& rng);
-	void mut_random_overwrite(std::string& input, Rng& rng);
-	void mut_random_insert(std::string& input, Rng& rng);
-	void mut_splice_overwrite(std::string& input, Rng& rng);
-	void mut_splice_insert(std::string& input, Rng& rng);
-};
\ No newline at end of file
+};
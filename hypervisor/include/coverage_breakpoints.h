@@ -3,12 +3,22 @@
 
 #include <set>
 #include <unordered_set>
+#include <vector>
 #include <atomic>
 #include "common.h"
+#include "hash.h"
 
 template <class SetContainer = std::set<vaddr_t>>
 class CoverageBreakpoints {
 public:
+	// Breakpoints are removed once hit, so the coverage of a run only has the
+	// blocks that were new to its VM, and not its whole path
+	static const bool HAS_PATHS = false;
+
+	CoverageBreakpoints();
+
+	// Fingerprints are compared first, so different coverages are usually
+	// told apart without comparing the sets
 	bool operator==(const CoverageBreakpoints& other) const;
 
 	// We want to be able to use this even when the other template type differs
@@ -21,18 +31,29 @@ public:
 
 	void reset();
 
+	// 64-bit fingerprint of the set of basic blocks. It is updated each time
+	// a block is added or removed, and it doesn't depend on the order.
+	uint64_t fingerprint() const;
+
 	bool contains(vaddr_t basic_block);
 
 	bool add(vaddr_t basic_block);
 
 	void remove(vaddr_t basic_block);
 
+	// Append every basic block to `keys`
+	void collect(std::vector<uint64_t>& keys) const;
+
+	// Add the basic blocks given by `collect`
+	void restore(const uint64_t* keys, size_t n);
+
 	// These are just used in the afl-cmin algorithm and may be removed later
 	typename SetContainer::iterator begin();
 	typename SetContainer::iterator end();
 
 private:
 	SetContainer m_basic_blocks;
+	uint64_t m_fingerprint;
 };
 
 
@@ -49,15 +70,26 @@ public:
 	template <class T>
 	bool add(const CoverageBreakpoints<T>& other);
 
+	// Same as CoverageBreakpoints::collect, but it can be called while other
+	// threads are adding coverage
+	void collect(std::vector<uint64_t>& keys) const;
+
 private:
-	std::atomic_flag m_lock;
+	mutable std::atomic_flag m_lock;
 };
 
 
 
+template <class T>
+CoverageBreakpoints<T>::CoverageBreakpoints()
+	: m_fingerprint(0)
+{
+}
+
 template <class T>
 bool CoverageBreakpoints<T>::operator==(const CoverageBreakpoints<T>& other) const {
-	return m_basic_blocks == other.m_basic_blocks;
+	return m_fingerprint == other.m_fingerprint &&
+	       m_basic_blocks == other.m_basic_blocks;
 }
 
 template <class T1>
@@ -68,6 +100,7 @@ CoverageBreakpoints<T1>& CoverageBreakpoints<T1>::operator=(
 	const T2& other_blocks = other.blocks();
 	m_basic_blocks.clear();
 	m_basic_blocks.insert(other_blocks.begin(), other_blocks.end());
+	m_fingerprint = other.fingerprint();
 	return *this;
 }
 
@@ -84,6 +117,12 @@ inline const T& CoverageBreakpoints<T>::blocks() const {
 template <class T>
 inline void CoverageBreakpoints<T>::reset() {
 	m_basic_blocks.clear();
+	m_fingerprint = 0;
+}
+
+template <class T>
+inline uint64_t CoverageBreakpoints<T>::fingerprint() const {
+	return m_fingerprint;
 }
 
 template <class T>
@@ -93,13 +132,28 @@ inline bool CoverageBreakpoints<T>::contains(vaddr_t basic_block) {
 
 template <class T>
 inline bool CoverageBreakpoints<T>::add(vaddr_t basic_block) {
+	// The fingerprint is the xor of the hashes of every block
 	bool inserted = m_basic_blocks.insert(basic_block).second;
+	if (inserted)
+		m_fingerprint ^= hash64_combine(0, basic_block);
 	return inserted;
 }
 
 template <class T>
 inline void CoverageBreakpoints<T>::remove(vaddr_t basic_block) {
-	m_basic_blocks.erase(basic_block);
+	if (m_basic_blocks.erase(basic_block))
+		m_fingerprint ^= hash64_combine(0, basic_block);
+}
+
+template <class T>
+inline void CoverageBreakpoints<T>::collect(std::vector<uint64_t>& keys) const {
+	keys.insert(keys.end(), m_basic_blocks.begin(), m_basic_blocks.end());
+}
+
+template <class T>
+inline void CoverageBreakpoints<T>::restore(const uint64_t* keys, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		add(keys[i]);
 }
 
 template <class T>
@@ -144,5 +198,11 @@ inline bool SharedCoverageBreakpoints::add(const CoverageBreakpoints<T>& other)
 	return new_cov;
 }
 
+inline void SharedCoverageBreakpoints::collect(std::vector<uint64_t>& keys) const {
+	while (m_lock.test_and_set());
+	CoverageBreakpoints::collect(keys);
+	m_lock.clear();
+}
+
 
 #endif
\ No newline at end of file
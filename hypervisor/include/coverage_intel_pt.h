@@ -4,9 +4,13 @@
 #include <vector>
 #include <atomic>
 #include "common.h"
+#include "hash.h"
 
 class CoverageIntelPT {
 public:
+	// The bitmap is reset before each run, so it has its whole path
+	static const bool HAS_PATHS = true;
+
 	CoverageIntelPT();
 	bool operator==(const CoverageIntelPT& other) const;
 
@@ -15,13 +19,30 @@ public:
 
 	void reset();
 
+	// 64-bit fingerprint of the bitmap. It hashes only its non-zero words,
+	// and it's cached until the bitmap changes.
+	uint64_t fingerprint() const;
+
+	// Forget the cached fingerprint. The bitmap is written by the decoder and
+	// not by us, so this must be called after decoding.
+	void invalidate_fingerprint();
+
+	// Append the index of every bit set in the bitmap to `keys`
+	void collect(std::vector<uint64_t>& keys) const;
+
+	// Set the bits given by `collect`
+	void restore(const uint64_t* keys, size_t n);
+
 private:
 	std::vector<uint8_t> m_bitmap;
+	mutable uint64_t m_fingerprint;
+	mutable bool m_fingerprint_valid;
 };
 
 class SharedCoverageIntelPT : CoverageIntelPT {
 public:
 	using CoverageIntelPT::operator=;
+	using CoverageIntelPT::collect;
 
 	SharedCoverageIntelPT();
 
@@ -37,6 +58,8 @@ private:
 
 inline CoverageIntelPT::CoverageIntelPT()
 	: m_bitmap(COVERAGE_BITMAP_SIZE)
+	, m_fingerprint(0)
+	, m_fingerprint_valid(false)
 {
 }
 
@@ -44,6 +67,28 @@ inline bool CoverageIntelPT::operator==(const CoverageIntelPT& other) const {
 	return m_bitmap == other.m_bitmap;
 }
 
+inline uint64_t CoverageIntelPT::fingerprint() const {
+	if (m_fingerprint_valid)
+		return m_fingerprint;
+
+	// The bitmap is mostly zeros, so skip them and hash each non-zero word
+	// with its position
+	uint64_t hash = 0;
+	size_t word;
+	for (size_t i = 0; i < m_bitmap.size(); i += sizeof(word)) {
+		word = *(const size_t*)(m_bitmap.data() + i);
+		if (word)
+			hash = hash64_combine(hash64_combine(hash, i), word);
+	}
+	m_fingerprint = hash;
+	m_fingerprint_valid = true;
+	return m_fingerprint;
+}
+
+inline void CoverageIntelPT::invalidate_fingerprint() {
+	m_fingerprint_valid = false;
+}
+
 inline uint8_t* CoverageIntelPT::bitmap() {
 	return m_bitmap.data();
 }
@@ -54,6 +99,25 @@ inline const uint8_t* CoverageIntelPT::bitmap() const {
 
 inline void CoverageIntelPT::reset() {
 	memset(m_bitmap.data(), 0, m_bitmap.size());
+	m_fingerprint = 0;
+	m_fingerprint_valid = true;
+}
+
+inline void CoverageIntelPT::collect(std::vector<uint64_t>& keys) const {
+	size_t word;
+	for (size_t i = 0; i < m_bitmap.size(); i += sizeof(word)) {
+		word = *(const size_t*)(m_bitmap.data() + i);
+		while (word) {
+			keys.push_back(i*8 + __builtin_ctzl(word));
+			word &= word - 1;
+		}
+	}
+}
+
+inline void CoverageIntelPT::restore(const uint64_t* keys, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		m_bitmap[keys[i] / 8] |= 1 << (keys[i] % 8);
+	m_fingerprint_valid = false;
 }
 
 
@@ -1,12 +1,20 @@
 #ifndef _COVERAGE_NONE_H
 #define _COVERAGE_NONE_H
 
+#include <vector>
+#include <cstdint>
+
 class CoverageNone {
 public:
+	static const bool HAS_PATHS = false;
+
 	bool operator==(const CoverageNone& other) const { return true; }
 	void reset() {}
+	uint64_t fingerprint() const { return 0; }
 	size_t count() const { return 0; }
 	bool add(const CoverageNone& other) { return false; }
+	void collect(std::vector<uint64_t>& keys) const {}
+	void restore(const uint64_t* keys, size_t n) {}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef _CRASH_MINIMIZER_H
+#define _CRASH_MINIMIZER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "vm.h"
+
+// Minimizes crashing inputs while keeping the same fault, using delta
+// debugging. First it removes chunks of decreasing size from the input as
+// ddmin does, trying both to keep only one chunk and to remove it, until no
+// single byte can be removed. Then it canonicalizes the remaining bytes,
+// replacing each one with CANONICAL_BYTE if the fault stays the same.
+// Crashes are minimized one at a time, and the candidates of each step are
+// run in parallel by every thread that calls `work`, each one in its own copy
+// of the base vm. The first candidate that keeps the fault is taken, so the
+// result is the same as trying them one by one.
+class CrashMinimizer {
+public:
+	// Byte that bytes are replaced with when canonicalizing, as in afl-tmin
+	static const char CANONICAL_BYTE = '0';
+
+	// Number of runs and time spent in each step
+	struct Profile {
+		size_t initial_size;
+		size_t final_size;
+		size_t removal_runs;
+		size_t canonicalization_runs;
+		double removal_time;
+		double canonicalization_time;
+	};
+
+	// Minimize using `nthreads` threads, which must call `work`
+	CrashMinimizer(const Vm& base, int nthreads);
+
+	// Run candidates in the calling thread until `stop` is called
+	void work();
+	void stop();
+
+	// Minimize `input` in place, which must crash with `fault`
+	Profile minimize(std::string& input, const FaultInfo& fault);
+
+private:
+	const Vm& m_base;
+	int m_nthreads;
+
+	// Candidates of the current step, and the fault they must keep. A new
+	// step is started by incrementing `m_step`, and it's over when every
+	// thread is done with it. Protected by `m_mutex`.
+	std::vector<std::string> m_candidates;
+	size_t m_num_candidates;
+	FaultInfo m_fault;
+	size_t m_step;
+	int m_threads_done;
+	bool m_stop;
+	std::mutex m_mutex;
+	std::condition_variable m_step_started;
+	std::condition_variable m_step_done;
+
+	// Index of the next candidate to run, and of the first one found that
+	// keeps the fault
+	std::atomic<size_t> m_next;
+	std::atomic<size_t> m_first;
+
+	// Number of candidates run
+	std::atomic<size_t> m_runs;
+
+	// Run the first `n` candidates in parallel, and return the index of the
+	// first one that crashes with `fault`, or `n` if none does
+	size_t first_crashing(size_t n, const FaultInfo& fault);
+
+	// Get candidate `i`, allocating it if needed
+	std::string& candidate(size_t i);
+
+	// Steps of the minimization
+	void remove_chunks(std::string& input, const FaultInfo& fault);
+	void canonicalize(std::string& input, const FaultInfo& fault);
+};
+
+#endif
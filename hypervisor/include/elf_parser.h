@@ -116,11 +116,13 @@ class ElfParser {
 		vaddr_t entry() const;
 		vaddr_t load_addr() const;
 		std::string path() const;
+		std::string name() const; // filename part of path
 		//std::string abs_path() const;
 		std::string interpreter() const;
 		std::vector<segment_t> segments() const;
 		std::vector<section_t> sections() const;
 		std::vector<symbol_t> symbols() const;
+		std::vector<symbol_t> function_symbols() const; // defined, sized
 		//std::vector<relocation_t> relocations() const;
 		std::pair<vaddr_t, vaddr_t> section_limits(const std::string& name) const;
 		std::pair<vaddr_t, vaddr_t> symbol_limits(const std::string& name) const;
@@ -0,0 +1,214 @@
+#ifndef _EXIT_PROFILE_H
+#define _EXIT_PROFILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Number of VM exits and cycles spent on them by exit reason and by hypercall
+// number, and number of debug exits by rip, which tell which breakpoints or
+// hooks are hit the most. Recording is a couple of increments, and profiles
+// can be merged and subtracted like histograms.
+// Debug rips are kept in a small hash table. When a rip can't be inserted
+// because its probe sequence is full it's counted as other, so counts are
+// exact for the hottest rips as long as there aren't too many of them.
+// Which rips fit in the table depends on the order they were inserted in, so
+// a profile can only be subtracted exactly from a later state of itself, and
+// intervals of merged profiles must be computed before merging them.
+class ExitProfile {
+public:
+	// Exit reasons and hypercall numbers out of range are counted in the last
+	// entry
+	static const size_t MAX_EXIT_REASONS = 128;
+	static const size_t MAX_HYPERCALLS   = 32;
+
+	static const size_t RIP_SLOTS  = 256;
+	static const size_t RIP_PROBES = 8;
+
+	ExitProfile();
+
+	void record_exit(uint32_t reason, uint64_t cycles);
+	void record_hypercall(uint64_t n, uint64_t cycles);
+	void record_debug(uint64_t rip);
+
+	// Add or subtract the values recorded in another profile. Debug exits of
+	// rips that aren't in the table are subtracted from the other exits.
+	void add(const ExitProfile& other);
+	void subtract(const ExitProfile& other);
+
+	// Add the values recorded in `now` since `old`, which must be an earlier
+	// state of the same profile
+	void add_interval(const ExitProfile& now, const ExitProfile& old);
+
+	// Relaxed atomic versions of `operator=` and `add`, for reading and
+	// writing profiles that other thread is accessing
+	void store_relaxed(const ExitProfile& other);
+	void add_relaxed(const ExitProfile& other);
+
+	uint64_t exits(size_t reason) const;
+	uint64_t exit_cycles(size_t reason) const;
+	uint64_t hypercalls(size_t n) const;
+	uint64_t hypercall_cycles(size_t n) const;
+
+	// Up to `n` rips with the most debug exits and their number of exits,
+	// sorted by that number, and debug exits of rips that weren't recorded
+	std::vector<std::pair<uint64_t, uint64_t>> top_debug_rips(size_t n) const;
+	uint64_t other_debug_exits() const;
+
+	// Name of a KVM exit reason
+	static const char* exit_reason_str(size_t reason);
+
+private:
+	struct Counter {
+		uint64_t count;
+		uint64_t cycles;
+	};
+
+	// Empty slots have rip 0, which can't be a breakpoint in the guest
+	struct RipSlot {
+		uint64_t rip;
+		uint64_t count;
+	};
+
+	Counter m_exits[MAX_EXIT_REASONS];
+	Counter m_hypercalls[MAX_HYPERCALLS];
+	RipSlot m_rips[RIP_SLOTS];
+	uint64_t m_other_rips;
+
+	void add_debug(uint64_t rip, uint64_t count);
+	RipSlot* find_debug(uint64_t rip);
+};
+
+
+inline ExitProfile::ExitProfile()
+	: m_exits{}
+	, m_hypercalls{}
+	, m_rips{}
+	, m_other_rips(0)
+{
+}
+
+inline void ExitProfile::record_exit(uint32_t reason, uint64_t cycles) {
+	Counter& counter = m_exits[reason < MAX_EXIT_REASONS ? reason
+	                                                     : MAX_EXIT_REASONS-1];
+	counter.count++;
+	counter.cycles += cycles;
+}
+
+inline void ExitProfile::record_hypercall(uint64_t n, uint64_t cycles) {
+	Counter& counter = m_hypercalls[n < MAX_HYPERCALLS ? n : MAX_HYPERCALLS-1];
+	counter.count++;
+	counter.cycles += cycles;
+}
+
+inline void ExitProfile::record_debug(uint64_t rip) {
+	add_debug(rip, 1);
+}
+
+inline void ExitProfile::add_debug(uint64_t rip, uint64_t count) {
+	size_t i = (rip * 0x9E3779B97F4A7C15) >> 56;
+	for (size_t j = 0; j < RIP_PROBES; j++) {
+		RipSlot& slot = m_rips[(i + j) % RIP_SLOTS];
+		if (slot.rip == rip || slot.rip == 0) {
+			slot.rip = rip;
+			slot.count += count;
+			return;
+		}
+	}
+	m_other_rips += count;
+}
+
+inline ExitProfile::RipSlot* ExitProfile::find_debug(uint64_t rip) {
+	size_t i = (rip * 0x9E3779B97F4A7C15) >> 56;
+	for (size_t j = 0; j < RIP_PROBES; j++) {
+		RipSlot& slot = m_rips[(i + j) % RIP_SLOTS];
+		if (slot.rip == rip)
+			return &slot;
+		if (slot.rip == 0)
+			return nullptr;
+	}
+	return nullptr;
+}
+
+inline void ExitProfile::add(const ExitProfile& other) {
+	for (size_t i = 0; i < MAX_EXIT_REASONS; i++) {
+		m_exits[i].count  += other.m_exits[i].count;
+		m_exits[i].cycles += other.m_exits[i].cycles;
+	}
+	for (size_t i = 0; i < MAX_HYPERCALLS; i++) {
+		m_hypercalls[i].count  += other.m_hypercalls[i].count;
+		m_hypercalls[i].cycles += other.m_hypercalls[i].cycles;
+	}
+	for (size_t i = 0; i < RIP_SLOTS; i++)
+		if (other.m_rips[i].rip && other.m_rips[i].count)
+			add_debug(other.m_rips[i].rip, other.m_rips[i].count);
+	m_other_rips += other.m_other_rips;
+}
+
+inline void ExitProfile::subtract(const ExitProfile& other) {
+	for (size_t i = 0; i < MAX_EXIT_REASONS; i++) {
+		m_exits[i].count  -= other.m_exits[i].count;
+		m_exits[i].cycles -= other.m_exits[i].cycles;
+	}
+	for (size_t i = 0; i < MAX_HYPERCALLS; i++) {
+		m_hypercalls[i].count  -= other.m_hypercalls[i].count;
+		m_hypercalls[i].cycles -= other.m_hypercalls[i].cycles;
+	}
+	for (size_t i = 0; i < RIP_SLOTS; i++) {
+		if (!other.m_rips[i].rip)
+			continue;
+		RipSlot* slot = find_debug(other.m_rips[i].rip);
+		if (slot)
+			slot->count -= other.m_rips[i].count;
+		else
+			m_other_rips -= other.m_rips[i].count;
+	}
+	m_other_rips -= other.m_other_rips;
+}
+
+inline void ExitProfile::add_interval(const ExitProfile& now,
+                                      const ExitProfile& old)
+{
+	ExitProfile interval = now;
+	interval.subtract(old);
+	add(interval);
+}
+
+inline void ExitProfile::store_relaxed(const ExitProfile& other) {
+	const uint64_t* src = (const uint64_t*)&other;
+	uint64_t* dst = (uint64_t*)this;
+	for (size_t i = 0; i < sizeof(ExitProfile)/sizeof(uint64_t); i++)
+		__atomic_store_n(&dst[i], src[i], __ATOMIC_RELAXED);
+}
+
+inline void ExitProfile::add_relaxed(const ExitProfile& other) {
+	ExitProfile copy;
+	const uint64_t* src = (const uint64_t*)&other;
+	uint64_t* dst = (uint64_t*)&copy;
+	for (size_t i = 0; i < sizeof(ExitProfile)/sizeof(uint64_t); i++)
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+	add(copy);
+}
+
+inline uint64_t ExitProfile::exits(size_t reason) const {
+	return m_exits[reason].count;
+}
+
+inline uint64_t ExitProfile::exit_cycles(size_t reason) const {
+	return m_exits[reason].cycles;
+}
+
+inline uint64_t ExitProfile::hypercalls(size_t n) const {
+	return m_hypercalls[n].count;
+}
+
+inline uint64_t ExitProfile::hypercall_cycles(size_t n) const {
+	return m_hypercalls[n].cycles;
+}
+
+inline uint64_t ExitProfile::other_debug_exits() const {
+	return m_other_rips;
+}
+
+#endif
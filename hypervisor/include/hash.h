@@ -0,0 +1,85 @@
+#ifndef _HASH_H
+#define _HASH_H
+
+#include <cstdint>
+#include <cstring>
+
+// Fast non-cryptographic 64-bit hash, based on wyhash (public domain):
+//   https://github.com/wangyi-fudan/wyhash
+namespace hash_internal {
+
+static const uint64_t P0 = 0xa0761d6478bd642full;
+static const uint64_t P1 = 0xe7037ed1a0b428dbull;
+static const uint64_t P2 = 0x8ebc6af09c88c6e3ull;
+static const uint64_t P3 = 0x589965cc75374cc3ull;
+
+inline uint64_t mix(uint64_t a, uint64_t b) {
+	unsigned __int128 r = (unsigned __int128)a * b;
+	return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+inline uint64_t read8(const uint8_t* p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+inline uint64_t read4(const uint8_t* p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+// Read 1 to 3 bytes
+inline uint64_t read3(const uint8_t* p, size_t len) {
+	return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+}
+
+}
+
+inline uint64_t hash64(const void* data, size_t len, uint64_t seed = 0) {
+	using namespace hash_internal;
+	const uint8_t* p = (const uint8_t*)data;
+	seed ^= mix(seed ^ P0, P1);
+	uint64_t a, b;
+	if (len <= 16) {
+		if (len >= 4) {
+			a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+			b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+		} else if (len > 0) {
+			a = read3(p, len);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = len;
+		if (i > 48) {
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = mix(read8(p) ^ P1, read8(p + 8) ^ seed);
+				see1 = mix(read8(p + 16) ^ P2, read8(p + 24) ^ see1);
+				see2 = mix(read8(p + 32) ^ P3, read8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = mix(read8(p) ^ P1, read8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = read8(p + i - 16);
+		b = read8(p + i - 8);
+	}
+	return mix(P1 ^ len, mix(a ^ P1, b ^ seed));
+}
+
+// Combine a 64-bit value into a hash
+inline uint64_t hash64_combine(uint64_t hash, uint64_t value) {
+	return hash_internal::mix(hash ^ hash_internal::P0,
+	                          value ^ hash_internal::P1);
+}
+
+#endif
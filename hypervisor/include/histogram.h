@@ -0,0 +1,124 @@
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Log-linear histogram of 64-bit values, as HDR histograms. Values are split
+// in power of two ranges, and each range is split in SUB_BUCKETS/2 linear
+// buckets, so the relative error of a value is at most 2/SUB_BUCKETS. Values
+// lower than SUB_BUCKETS have their own bucket. Recording is just an increment,
+// and histograms can be merged and subtracted bucket by bucket.
+class Histogram {
+public:
+	static const int SUB_BUCKET_BITS = 4;
+	static const uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const uint64_t HALF_SUB_BUCKETS = SUB_BUCKETS / 2;
+	static const size_t NUM_BUCKETS =
+		(64 - SUB_BUCKET_BITS)*HALF_SUB_BUCKETS + SUB_BUCKETS;
+
+	Histogram();
+
+	void record(uint64_t value);
+
+	// Add or subtract the values recorded in another histogram
+	void add(const Histogram& other);
+	void subtract(const Histogram& other);
+
+	// Relaxed atomic versions of `operator=` and `add`, for reading and
+	// writing histograms that other thread is accessing
+	void store_relaxed(const Histogram& other);
+	void add_relaxed(const Histogram& other);
+
+	uint64_t count() const;
+
+	// Value at quantile `q`, from 0 to 1. As values in the same bucket can't
+	// be told apart, this is the highest value of its bucket.
+	uint64_t percentile(double q) const;
+	uint64_t max() const;
+
+private:
+	uint64_t m_counts[NUM_BUCKETS];
+
+	static size_t bucket(uint64_t value);
+	static uint64_t highest_value(size_t bucket);
+};
+
+
+inline Histogram::Histogram()
+	: m_counts{}
+{
+}
+
+inline size_t Histogram::bucket(uint64_t value) {
+	if (value < SUB_BUCKETS)
+		return value;
+	int msb = 63 - __builtin_clzl(value);
+	int shift = msb - SUB_BUCKET_BITS + 1;
+	return shift*HALF_SUB_BUCKETS + (value >> shift);
+}
+
+inline uint64_t Histogram::highest_value(size_t bucket) {
+	if (bucket < SUB_BUCKETS)
+		return bucket;
+	int shift = bucket/HALF_SUB_BUCKETS - 1;
+	uint64_t sub_bucket = bucket%HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+	return ((sub_bucket + 1) << shift) - 1;
+}
+
+inline void Histogram::record(uint64_t value) {
+	m_counts[bucket(value)]++;
+}
+
+inline void Histogram::add(const Histogram& other) {
+	for (size_t i = 0; i < NUM_BUCKETS; i++)
+		m_counts[i] += other.m_counts[i];
+}
+
+inline void Histogram::subtract(const Histogram& other) {
+	for (size_t i = 0; i < NUM_BUCKETS; i++)
+		m_counts[i] -= other.m_counts[i];
+}
+
+inline void Histogram::store_relaxed(const Histogram& other) {
+	for (size_t i = 0; i < NUM_BUCKETS; i++)
+		__atomic_store_n(&m_counts[i], other.m_counts[i], __ATOMIC_RELAXED);
+}
+
+inline void Histogram::add_relaxed(const Histogram& other) {
+	for (size_t i = 0; i < NUM_BUCKETS; i++)
+		m_counts[i] += __atomic_load_n(&other.m_counts[i], __ATOMIC_RELAXED);
+}
+
+inline uint64_t Histogram::count() const {
+	uint64_t count = 0;
+	for (size_t i = 0; i < NUM_BUCKETS; i++)
+		count += m_counts[i];
+	return count;
+}
+
+inline uint64_t Histogram::percentile(double q) const {
+	uint64_t total = count();
+	if (total == 0)
+		return 0;
+	// Number of values that must be lower or equal, rounded up
+	uint64_t target = q*total;
+	if (target < q*total || target == 0)
+		target++;
+	uint64_t accum = 0;
+	for (size_t i = 0; i < NUM_BUCKETS; i++) {
+		accum += m_counts[i];
+		if (accum >= target)
+			return highest_value(i);
+	}
+	return max();
+}
+
+inline uint64_t Histogram::max() const {
+	for (size_t i = NUM_BUCKETS; i > 0; i--)
+		if (m_counts[i-1])
+			return highest_value(i-1);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _INPUT_READ_INFO_H
+#define _INPUT_READ_INFO_H
+
+#include "common.h"
+
+// Keep this the same as in the kernel
+struct InputReadInfo {
+	static const size_t MAX_RANGES = 16;
+	struct Range {
+		size_t start;
+		size_t end;
+	};
+
+	// End of the furthest read performed on the input
+	size_t max_offset;
+
+	// Whether the input size was observed by other means than reading until
+	// the end of the input, such as stat or lseek
+	bool size_observed;
+
+	// Sorted disjoint ranges of the input that were read. If there were more
+	// than MAX_RANGES, some of them were merged with the gap between them.
+	size_t num_ranges;
+	Range ranges[MAX_RANGES];
+
+	// Info for an input of given size when the kernel doesn't report it. We
+	// have to assume the whole input was read.
+	static InputReadInfo whole(size_t size) {
+		InputReadInfo info;
+		info.max_offset    = size;
+		info.size_observed = true;
+		info.num_ranges    = (size ? 1 : 0);
+		info.ranges[0]     = { 0, size };
+		return info;
+	}
+};
+
+#endif
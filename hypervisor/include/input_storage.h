@@ -0,0 +1,128 @@
+#ifndef _INPUT_STORAGE_H
+#define _INPUT_STORAGE_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include "common.h"
+
+// Non-owning reference to an input stored in an InputStorage, similar to
+// std::string_view
+class InputRef {
+public:
+	InputRef();
+	InputRef(const char* data, size_t size);
+
+	const char* data() const;
+	size_t size() const;
+	bool empty() const;
+	char operator[](size_t i) const;
+	const char* begin() const;
+	const char* end() const;
+
+	bool operator==(const InputRef& other) const;
+
+	// Copy the input into a string
+	std::string str() const;
+
+private:
+	const char* m_data;
+	size_t m_size;
+};
+
+// Storage for corpus inputs. Inputs are copied into big chunks of memory
+// instead of being allocated separately, and identical inputs are stored
+// only once. Stored inputs never move, so references to them can be used
+// without locking while other inputs are stored.
+// Calls to `store` and `clear` must be serialized by the caller.
+class InputStorage {
+public:
+	static const size_t CHUNK_SIZE = 16*1024*1024;
+
+	InputStorage();
+	~InputStorage();
+
+	InputStorage(const InputStorage&) = delete;
+	InputStorage& operator=(const InputStorage&) = delete;
+
+	// Store an input and return a reference to it. If an identical input was
+	// already stored, return a reference to that one instead.
+	InputRef store(const char* data, size_t size);
+	InputRef store(const std::string& input);
+
+	// Register an input whose memory is not ours, such as a mapped file that
+	// outlives the storage. It is not copied, but it is used for deduplicating
+	// the inputs stored after it.
+	InputRef adopt(const char* data, size_t size);
+
+	// Number of bytes of the stored inputs
+	size_t memsize() const;
+
+	// Number of times an input was already stored
+	size_t dedups() const;
+
+	// Free every input. References become invalid.
+	void clear();
+
+private:
+	// Chunks of memory, and the free space in the last one
+	std::vector<char*> m_chunks;
+	char* m_free;
+	size_t m_free_size;
+
+	// Stored inputs indexed by hash of their content
+	std::unordered_multimap<uint64_t, InputRef> m_inputs;
+
+	std::atomic<size_t> m_memsize;
+	std::atomic<size_t> m_dedups;
+
+	char* alloc(size_t size);
+};
+
+
+inline InputRef::InputRef()
+	: m_data("")
+	, m_size(0)
+{
+}
+
+inline InputRef::InputRef(const char* data, size_t size)
+	: m_data(data)
+	, m_size(size)
+{
+}
+
+inline const char* InputRef::data() const {
+	return m_data;
+}
+
+inline size_t InputRef::size() const {
+	return m_size;
+}
+
+inline bool InputRef::empty() const {
+	return m_size == 0;
+}
+
+inline char InputRef::operator[](size_t i) const {
+	return m_data[i];
+}
+
+inline const char* InputRef::begin() const {
+	return m_data;
+}
+
+inline const char* InputRef::end() const {
+	return m_data + m_size;
+}
+
+inline bool InputRef::operator==(const InputRef& other) const {
+	return m_size == other.m_size && memcmp(m_data, other.m_data, m_size) == 0;
+}
+
+inline std::string InputRef::str() const {
+	return std::string(m_data, m_size);
+}
+
+#endif
@@ -76,7 +76,14 @@ struct kvm_dirty_gfn {
 #define MSR_GS_BASE          0xc0000101 /* 64bit GS base */
 #define MSR_KERNEL_GS_BASE   0xc0000102 /* SwapGS GS shadow */
 #define MSR_TSC_AUX          0xc0000103 /* Auxiliary TSC */
+#define MSR_PERFEVTSEL0      0x00000186
+#define MSR_PERFEVTSEL1      0x00000187
+#define MSR_PERFEVTSEL2      0x00000188
+#define MSR_PMC0             0x000000C1
+#define MSR_PMC1             0x000000C2
+#define MSR_PMC2             0x000000C3
 #define MSR_FIXED_CTR0       0x00000309
+#define MSR_FIXED_CTR1       0x0000030A
 #define MSR_FIXED_CTR_CTRL   0x0000038D
 #define MSR_PERF_GLOBAL_CTRL 0x0000038F
 
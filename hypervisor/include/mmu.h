@@ -5,6 +5,7 @@
 #include "elf_parser.h"
 #include "common.h"
 #include "kvm_aux.h"
+#include "shared_mem.h"
 
 class Mmu {
 public:
@@ -15,6 +16,9 @@ public:
 	static const vaddr_t PHYSMAP_ADDR            = 0xFFFFFF8000000000;
 	static const vaddr_t INTERPRETER_ADDR        = 0x400000000000;
 
+	// Memory shared with the guest kernel is right after physical memory
+	static const psize_t SHARED_MEM_SIZE = PAGE_CEIL(sizeof(SharedMem));
+
 	// Normal constructor
 	Mmu(int vm_fd, int vcpu_fd, size_t mem_size);
 
@@ -33,10 +37,27 @@ public:
 	paddr_t next_frame_alloc() const;
 	void disable_allocations();
 
+	// Memory shared with the guest kernel, and its guest virtual address in
+	// the physmap. Each Mmu has its own, which is never reset.
+	SharedMem& shared_mem();
+	const SharedMem& shared_mem() const;
+	vaddr_t shared_mem_vaddr() const;
+
 	// Reset to the state in `other`, given that current Mmu has been
 	// constructed as a copy of `other`. Returns the number of pages resetted
 	size_t reset(const Mmu& other);
 
+	// Save the physical address and the content of every page dirtied since
+	// last reset into `pages` and `memory`. Those pages will still be
+	// restored in next reset.
+	void save_dirty_pages(std::vector<paddr_t>& pages,
+	                      std::vector<uint8_t>& memory);
+
+	// Write pages saved with `save_dirty_pages` by this Mmu or by any other
+	// Mmu constructed as a copy of the same Mmu, marking them as dirty
+	void restore_pages(const std::vector<paddr_t>& pages,
+	                   const std::vector<uint8_t>& memory);
+
 	// Allocate a physical page
 	paddr_t alloc_frame();
 
@@ -100,6 +121,9 @@ private:
 	uint8_t* m_memory;
 	size_t   m_length;
 
+	// Memory shared with the guest, in a memslot without dirty logging
+	SharedMem* m_shared_mem;
+
 	// Pointer to page table level 4
 	// (at physical address PAGE_TABLE_PADDR)
 	paddr_t  m_ptl4;
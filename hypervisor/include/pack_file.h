@@ -0,0 +1,105 @@
+#ifndef _PACK_FILE_H
+#define _PACK_FILE_H
+
+#include <string>
+#include <vector>
+#include "common.h"
+#include "input_read_info.h"
+#include "input_storage.h"
+#include "scheduler.h"
+
+// Append-only storage of corpus entries, so a campaign can be resumed without
+// reading every input file and running it again. It is made of two files:
+// - The data file has the blobs of each entry: its input followed by the
+//   keys of its coverage, as given by Coverage::collect.
+// - The index file has a header and a fixed size record for each entry, with
+//   its metadata and the offsets of its blobs.
+// Records are appended after their blobs, so an entry is only in the pack once
+// its record is complete. Incomplete entries at the end, left by a campaign
+// that was killed while appending, are discarded when opening.
+// Entries that were in the files when they were opened are mapped, so their
+// inputs and coverage can be used without copying them.
+class PackFile {
+public:
+	// Keep this the same while the format doesn't change
+	static const uint64_t MAGIC = 0x3230304b43415046; // "FPACK002"
+
+	static constexpr const char* INDEX_EXT = ".idx";
+	static constexpr const char* DATA_EXT  = ".data";
+
+	struct Record {
+		uint64_t input_offset;
+		uint64_t input_size;
+		uint64_t coverage_offset;
+		uint64_t coverage_size;
+		uint64_t path;
+		uint64_t depth;
+		ExecInfo exec_info;
+		InputReadInfo read_info;
+	};
+
+	// Open an existing pack
+	PackFile(const std::string& path);
+
+	// Create a new pack for inputs of at most `max_input_size` bytes,
+	// replacing any existing one
+	PackFile(const std::string& path, size_t max_input_size);
+
+	~PackFile();
+
+	PackFile(const PackFile&) = delete;
+	PackFile& operator=(const PackFile&) = delete;
+
+	// Whether there is a pack at `path`
+	static bool exists(const std::string& path);
+
+	// Number of entries, including the ones appended after opening
+	size_t size() const;
+
+	// Max input size given when the pack was created
+	size_t max_input_size() const;
+
+	// Number of entries that were mapped when opening. Only these can be
+	// accessed with the functions below.
+	size_t mapped_size() const;
+
+	const Record& record(size_t i) const;
+	InputRef input(size_t i) const;
+	const uint64_t* coverage(size_t i) const;
+
+	// Append an entry. Calls must be serialized by the caller.
+	void append(const char* input, size_t size,
+	            const std::vector<uint64_t>& coverage, uint64_t path,
+	            size_t depth, const ExecInfo& exec_info,
+	            const InputReadInfo& read_info);
+
+	// Make sure appended entries are written to disk
+	void sync();
+
+private:
+	struct Header {
+		uint64_t magic;
+		uint64_t record_size;
+		uint64_t max_input_size;
+		uint64_t reserved;
+	};
+
+	int m_index_fd;
+	int m_data_fd;
+
+	// Mapped files. Records are right after the header in the index file
+	const char* m_index;
+	size_t m_index_map_size;
+	const Record* m_records;
+	const char* m_data;
+	size_t m_data_map_size;
+	size_t m_mapped_size;
+
+	// Current number of entries and size of the data file
+	size_t m_size;
+	size_t m_data_size;
+
+	size_t m_max_input_size;
+};
+
+#endif
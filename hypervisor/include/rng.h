@@ -0,0 +1,107 @@
+#ifndef _RNG_H
+#define _RNG_H
+
+#include <x86intrin.h>
+#include "common.h"
+
+// Used for mutating inputs. We don't use glibc rand() because it uses locks
+// in order to be thread safe. Instead, we implement a simpler algorithm, and
+// each thread will have its own rng. Rngs are seeded explicitly, so the
+// random stream of each thread can be reproduced.
+class Rng {
+	private:
+		uint64_t x_state;
+		uint64_t y_state;
+		uint64_t z_state;
+
+		// State of a two-lane xorshift128+, used for filling large buffers
+		__m128i simd_state0;
+		__m128i simd_state1;
+
+		// Buffers smaller than this are filled with words from RomuTrio
+		static const size_t SIMD_FILL_THRESHOLD = 64;
+
+		inline uint64_t rotl(uint64_t n, unsigned int rot) {
+			return (n << rot) | (n >> (8*sizeof(n) - rot));
+		}
+
+		// Used for expanding the seed into the generator states
+		static inline uint64_t splitmix64(uint64_t& state) {
+			uint64_t z = (state += 0x9e3779b97f4a7c15);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+			return z ^ (z >> 31);
+		}
+
+	public:
+		Rng(uint64_t seed){
+			x_state = splitmix64(seed);
+			y_state = splitmix64(seed);
+			z_state = splitmix64(seed);
+			simd_state0 = _mm_set_epi64x(splitmix64(seed), splitmix64(seed));
+			simd_state1 = _mm_set_epi64x(splitmix64(seed), splitmix64(seed));
+		}
+
+		inline uint64_t rnd(){
+			// RomuTrio
+			uint64_t xp = x_state, yp = y_state, zp = z_state;
+			x_state = 15241094284759029579u * zp;
+			y_state = yp - xp;  y_state = rotl(y_state, 12);
+			z_state = zp - yp;  z_state = rotl(z_state, 44);
+			return xp;
+		}
+
+		inline uint64_t rnd(uint64_t min, uint64_t max){
+			ASSERT(max >= min, "rnd bad range: %lu, %lu", min, max);
+			// Lemire's multiply-shift range reduction, which avoids the
+			// division. The bias is at most range/2^64, which we don't care
+			// about. A range of 0 means the whole 64 bits range.
+			uint64_t range = max - min + 1;
+			if (range == 0)
+				return rnd();
+			return min + (uint64_t)(((unsigned __int128)rnd() * range) >> 64);
+		}
+
+		inline uint64_t rnd_exp(uint64_t min, uint64_t max){
+			uint64_t x = rnd(min, max);
+			return rnd(min, x);
+		}
+
+		// Fill `buf` with `len` random bytes
+		inline void fill(void* buf, size_t len){
+			uint8_t* p = (uint8_t*)buf;
+
+			// Fill 16 bytes at a time with xorshift128+
+			if (len >= SIMD_FILL_THRESHOLD) {
+				__m128i s0 = simd_state0, s1 = simd_state1;
+				while (len >= 16) {
+					__m128i x = s0, y = s1;
+					s0 = y;
+					x = _mm_xor_si128(x, _mm_slli_epi64(x, 23));
+					s1 = _mm_xor_si128(_mm_xor_si128(x, y),
+					     _mm_xor_si128(_mm_srli_epi64(x, 17),
+					                   _mm_srli_epi64(y, 26)));
+					_mm_storeu_si128((__m128i*)p, _mm_add_epi64(s1, y));
+					p += 16;
+					len -= 16;
+				}
+				simd_state0 = s0;
+				simd_state1 = s1;
+			}
+
+			// Fill the rest 8 bytes at a time
+			uint64_t word;
+			while (len >= 8) {
+				word = rnd();
+				memcpy(p, &word, 8);
+				p += 8;
+				len -= 8;
+			}
+			if (len) {
+				word = rnd();
+				memcpy(p, &word, len);
+			}
+		}
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _SAMPLER_H
+#define _SAMPLER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include "elf_parser.h"
+
+// Profile of where the guest spends its cycles, built from the rips sampled by
+// the guest kernel. Samples are attributed to the function they fall into,
+// using the symbols of the given elfs, and written as folded stacks
+// ("module;function count" lines), which flamegraph.pl and speedscope can
+// read. Samples are leaf-only: guest memory is reset before the hypervisor
+// reads the samples, so stacks can't be unwound.
+// It is shared by every worker.
+class Sampler {
+public:
+	Sampler(const std::vector<const ElfParser*>& elfs);
+
+	// Add the samples taken by a worker, and the number of samples it lost
+	void add(const std::vector<vaddr_t>& rips, uint64_t lost);
+
+	// Write the samples added so far to `path`
+	void write_folded(const std::string& path) const;
+
+private:
+	struct Function {
+		vaddr_t start;
+		vaddr_t end;
+		std::string name;
+	};
+
+	// Functions sorted by start address, and number of samples of each one.
+	// Samples that don't fall into any function are counted in the last
+	// entry of m_counts.
+	std::vector<Function> m_functions;
+	std::vector<uint64_t> m_counts;
+	uint64_t m_lost;
+	mutable std::mutex m_mutex;
+
+	size_t function_index(vaddr_t rip) const;
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include "common.h"
+#include "append_only_vector.h"
+#include "stats.h"
+#include "rng.h"
+
+// Cost of executing an input, measured when it's added to the corpus, and
+// whether the run timed out. It is saved in the pack, so resumed campaigns
+// know which seeds timed out without running them again.
+struct ExecInfo {
+	cycle_t  cycles;
+	uint64_t instructions;
+	bool     timeout;
+};
+
+// Power scheduler. It keeps some metadata of every corpus entry, and uses it
+// to give each entry a score, as AFL does. Entries are chosen for mutation
+// with probability proportional to their score, using an alias table that is
+// rebuilt periodically by `update`, which is expected to be called from a
+// background thread. Entries added after the last update are not in the table
+// yet, and are chosen uniformly some of the time.
+// Before rebuilding the table, `update` also culls the corpus as afl-cmin
+// does: for each covered block or edge it finds the smallest and fastest entry
+// that covers it, and the entries that are needed to keep all the coverage
+// are marked as favored. Entries that are not favored get a lower score.
+class Scheduler {
+public:
+	// How scores are calculated from metadata:
+	// - Explore: only exec cost and depth, like AFL's default schedule.
+	// - Fast: also favour entries that have found new coverage and those that
+	//   haven't been chosen many times, like AFLFast's FAST schedule.
+	// - Rare: strongly favour entries that have been chosen fewer times than
+	//   the average.
+	enum Schedule {
+		Explore,
+		Fast,
+		Rare,
+	};
+
+	static const char* schedule_str[];
+
+	// Maximum number of entries. Metadata arrays are reserved for this amount
+	// of entries, but memory is only used as entries are added.
+	static const size_t MAX_ENTRIES = 1 << 22;
+
+	Scheduler(int nthreads, Schedule schedule);
+	~Scheduler();
+
+	Scheduler(const Scheduler&) = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+
+	// Parse a schedule name, returning whether it is valid
+	static bool parse_schedule(const std::string& name, Schedule& schedule);
+
+	size_t size() const;
+
+	// Register corpus entry `i`, which must be the next one. Depth is the
+	// number of mutation generations from a seed, and `coverage` has the keys
+	// of the blocks or edges it covers, as given by Coverage::collect. Calls
+	// to this must be serialized by the caller.
+	void add_entry(size_t i, size_t size, const ExecInfo& exec_info,
+	               size_t depth, const std::vector<uint64_t>& coverage);
+
+	size_t depth(size_t i) const;
+
+	// Number of favored entries in the last update
+	size_t favored() const;
+
+	// Register that entry `i` was mutated into an input that found new
+	// coverage
+	void coverage_found(size_t i);
+
+	// Choose the entry thread `id` will mutate next
+	size_t choose(int id, Rng& rng);
+
+	// Cull the corpus, recalculate scores and rebuild the alias table. Workers
+	// don't wait for this.
+	void update();
+
+private:
+	// AFL's limits for the score
+	static const uint64_t MIN_SCORE = 1;
+	static const uint64_t MAX_SCORE = 1600;
+
+	// Factor by which the score of entries that are not favored is reduced
+	static const uint64_t NOT_FAVORED_PENALTY = 20;
+
+	// Alias table for choosing entries with probability proportional to their
+	// score in constant time. Entry `i` is chosen when
+	// `rnd() < threshold[i]`, and `alias[i]` is chosen otherwise.
+	struct AliasTable {
+		std::vector<uint64_t> threshold;
+		std::vector<uint32_t> alias;
+
+		size_t size() const;
+		void build(const std::vector<double>& scores);
+	};
+
+	Schedule m_schedule;
+
+	// Metadata of each entry, in structure of arrays layout so calculating
+	// scores only touches the fields that are needed. Writes from several
+	// threads are relaxed, as we only need approximate values.
+	std::atomic<uint64_t>* m_exec_cycles;
+	std::atomic<uint64_t>* m_size;
+	std::atomic<uint64_t>* m_instructions;
+	std::atomic<uint64_t>* m_times_selected;
+	std::atomic<uint64_t>* m_coverage_found;
+	std::atomic<uint64_t>* m_depth;
+	std::atomic<size_t> m_num_entries;
+
+	// Last built table, its version and the lock for accessing them
+	AliasTable m_table;
+	std::atomic<size_t> m_table_version;
+	std::atomic_flag m_lock_table;
+
+	// Copy of the table for each thread, and its version. No need to lock
+	std::vector<AliasTable> m_thread_tables;
+	std::vector<size_t> m_thread_table_versions;
+
+	// Coverage of each entry
+	AppendOnlyVector<std::vector<uint64_t>> m_coverages;
+
+	// Culling state, only accessed by `update`. For each key, the entry with
+	// the lowest cost (size times exec cycles) that covers it. Entries from
+	// `m_culled_entries` on haven't been considered yet.
+	std::unordered_map<uint64_t, size_t> m_top_rated;
+	size_t m_culled_entries;
+	std::vector<bool> m_favored;
+	std::atomic<size_t> m_num_favored;
+
+	// Scores, kept here to avoid allocating memory on each update
+	std::vector<double> m_scores;
+
+	// Update the favored entries with entries added since last time. Return
+	// whether they changed.
+	bool cull(size_t n);
+
+	double score(size_t i, double avg_cost, double avg_instr,
+	             double avg_size, double avg_selected) const;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef _SHARED_MEM_H
+#define _SHARED_MEM_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Count and cycles spent by the guest kernel handling each syscall
+// Keep this the same as in the kernel
+struct SyscallProfile {
+	static const size_t MAX_SYSCALLS = 500;
+	uint64_t counts[MAX_SYSCALLS];
+	uint64_t cycles[MAX_SYSCALLS];
+
+	SyscallProfile();
+
+	// Add or subtract the values recorded in another profile
+	void add(const SyscallProfile& other);
+	void subtract(const SyscallProfile& other);
+
+	// Relaxed atomic versions of `operator=` and `add`, for reading and
+	// writing profiles that other thread is accessing
+	void store_relaxed(const SyscallProfile& other);
+	void add_relaxed(const SyscallProfile& other);
+};
+
+// Ring of rips sampled by the guest kernel. `head` is the number of samples
+// written since the vm was created, and the sample `i` is at `rips[i % SIZE]`.
+// Only the guest writes to it, and the hypervisor reads it between runs.
+// Keep this the same as in the kernel
+struct SampleRing {
+	static const size_t SIZE = 4096;
+	uint64_t head;
+	uint64_t rips[SIZE];
+};
+
+// Memory shared with the guest kernel. It lives in its own memslot, which is
+// not dirty logged: the guest writing to it doesn't dirty pages, and it isn't
+// restored when resetting the vm. This way the guest can accumulate stats
+// across runs at no cost, and the hypervisor reads them when it needs them.
+// Keep this the same as in the kernel
+struct SharedMem {
+	SyscallProfile syscalls;
+	SampleRing samples;
+};
+
+
+inline SyscallProfile::SyscallProfile()
+	: counts{}
+	, cycles{}
+{
+}
+
+inline void SyscallProfile::add(const SyscallProfile& other) {
+	for (size_t i = 0; i < MAX_SYSCALLS; i++) {
+		counts[i] += other.counts[i];
+		cycles[i] += other.cycles[i];
+	}
+}
+
+inline void SyscallProfile::subtract(const SyscallProfile& other) {
+	for (size_t i = 0; i < MAX_SYSCALLS; i++) {
+		counts[i] -= other.counts[i];
+		cycles[i] -= other.cycles[i];
+	}
+}
+
+inline void SyscallProfile::store_relaxed(const SyscallProfile& other) {
+	for (size_t i = 0; i < MAX_SYSCALLS; i++) {
+		__atomic_store_n(&counts[i], other.counts[i], __ATOMIC_RELAXED);
+		__atomic_store_n(&cycles[i], other.cycles[i], __ATOMIC_RELAXED);
+	}
+}
+
+inline void SyscallProfile::add_relaxed(const SyscallProfile& other) {
+	for (size_t i = 0; i < MAX_SYSCALLS; i++) {
+		counts[i] += __atomic_load_n(&other.counts[i], __ATOMIC_RELAXED);
+		cycles[i] += __atomic_load_n(&other.cycles[i], __ATOMIC_RELAXED);
+	}
+}
+
+#endif
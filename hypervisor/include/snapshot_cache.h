@@ -0,0 +1,66 @@
+#ifndef _SNAPSHOT_CACHE_H
+#define _SNAPSHOT_CACHE_H
+
+#include <list>
+#include <unordered_map>
+#include "vm.h"
+
+// Per-thread bounded LRU cache of snapshots, indexed by the corpus element
+// the input was mutated from. Mutations usually keep most of the input intact,
+// so a snapshot taken at the point where the guest reads the first mutated
+// byte lets us skip the execution of the common prefix. Snapshots are only
+// taken for hot elements, which are the ones that have been selected for
+// mutation at least HOT_THRESHOLD times.
+class SnapshotCache {
+public:
+	static const size_t HOT_THRESHOLD = 16;
+
+	// A snapshot that isn't valid for this many inputs in a row is replaced,
+	// as mutations of its element are happening before its offset
+	static const size_t MAX_MISSES = 16;
+
+	// Create a cache which will use at most `max_memsize` bytes. A cache with
+	// size 0 is disabled.
+	SnapshotCache(size_t max_memsize);
+
+	bool enabled() const;
+	size_t size() const;
+	size_t memsize() const;
+
+	// Get a snapshot for corpus element `i` which is valid for `input`, or
+	// nullptr if there's none
+	const Snapshot* get(size_t i, const std::string& input);
+
+	// Register that corpus element `i` has been selected for mutation, and
+	// return whether we want a snapshot of it, or a new one if it has one
+	// that keeps missing
+	bool wants_snapshot(size_t i);
+
+	// Insert a snapshot for corpus element `i`, replacing the previous one and
+	// evicting least recently used snapshots if needed
+	void insert(size_t i, Snapshot& snapshot);
+
+private:
+	struct Entry {
+		Snapshot snapshot;
+		std::list<size_t>::iterator lru_it;
+
+		// Inputs in a row the snapshot wasn't valid for
+		size_t misses;
+	};
+
+	size_t m_max_memsize;
+	size_t m_memsize;
+
+	// Snapshots indexed by corpus element, and list of corpus elements
+	// ordered from most to least recently used
+	std::unordered_map<size_t, Entry> m_snapshots;
+	std::list<size_t> m_lru;
+
+	// Number of times each corpus element has been selected
+	std::unordered_map<size_t, size_t> m_selections;
+
+	void evict(size_t i);
+};
+
+#endif
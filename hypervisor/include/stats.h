@@ -2,8 +2,13 @@
 #define _STATS_H
 
 #include <cstdint>
-#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
 #include <x86intrin.h> // _rdtsc()
+#include "histogram.h"
+#include "exit_profile.h"
+#include "shared_mem.h"
 
 /* Timetracing:
  *   - 0 means no timetracing
@@ -16,80 +21,178 @@
 typedef unsigned long long cycle_t;
 
 // STATS
+// List of every counter. Adding a counter here is enough for it to be
+// published by workers and summed for reporting. The same goes for histograms.
+#define STATS_COUNTERS(X) \
+	X(uint64_t, cases)             \
+	X(uint64_t, instr)             \
+	X(uint64_t, kernel_instr)      \
+	X(uint64_t, user_cycles)       \
+	X(uint64_t, kernel_cycles)     \
+	X(uint64_t, crashes)           \
+	X(uint64_t, timeouts)          \
+	X(uint64_t, vm_exits)          \
+	X(uint64_t, vm_exits_hc)       \
+	X(uint64_t, vm_exits_debug)    \
+	X(uint64_t, vm_exits_cov)      \
+	X(uint64_t, snapshot_hits)     \
+	X(uint64_t, snapshots_taken)   \
+	X(uint64_t, trim_runs)         \
+	X(uint64_t, trimmed_bytes)     \
+	X(uint64_t, dup_inputs)        \
+	X(cycle_t,  total_cycles)      \
+	X(cycle_t,  reset_cycles)      \
+	X(cycle_t,  reset_pages)       \
+	X(cycle_t,  run_cycles)        \
+	X(cycle_t,  hypercall_cycles)  \
+	X(cycle_t,  kvm_cycles)        \
+	X(cycle_t,  mut_cycles)        \
+	X(cycle_t,  mut1_cycles)       \
+	X(cycle_t,  mut2_cycles)       \
+	X(cycle_t,  set_input_cycles)  \
+	X(cycle_t,  update_cov_cycles) \
+	X(cycle_t,  report_cov_cycles) \
+	X(cycle_t,  snapshot_cycles)   \
+	X(cycle_t,  trim_cycles)
+
+// List of every histogram, for finding the tail latency of things whose
+// average is given by the counters
+#define STATS_HISTOGRAMS(X) \
+	X(run_cycles_hist)       \
+	X(reset_cycles_hist)     \
+	X(reset_pages_hist)      \
+	X(mut_cycles_hist)       \
+	X(kvm_cycles_hist)       \
+	X(hypercall_cycles_hist)
+
+// Stats of a single thread, which only that thread writes
 struct Stats {
-	uint64_t cases {0};
-	uint64_t instr {0};
-	uint64_t crashes {0};
-	uint64_t timeouts {0};
-	uint64_t vm_exits {0};
-	uint64_t vm_exits_hc {0};
-	uint64_t vm_exits_debug {0};
-	uint64_t vm_exits_cov {0};
-	cycle_t  total_cycles {0};
-	cycle_t  reset_cycles {0};
-	cycle_t  reset_pages {0};
-	cycle_t  run_cycles {0};
-	cycle_t  hypercall_cycles {0};
-	cycle_t  kvm_cycles {0};
-	cycle_t  mut_cycles {0};
-	cycle_t  mut1_cycles {0};
-	cycle_t  mut2_cycles {0};
-	cycle_t  set_input_cycles {0};
-	cycle_t  update_cov_cycles {0};
-	cycle_t  report_cov_cycles {0};
-	std::atomic_flag lock = ATOMIC_FLAG_INIT;
-
-	Stats() {};
-
-	Stats(const Stats& other) {
-		cases             = other.cases;
-		instr             = other.instr;
-		crashes           = other.crashes;
-		timeouts          = other.timeouts;
-		vm_exits          = other.vm_exits;
-		vm_exits_hc       = other.vm_exits_hc;
-		vm_exits_debug    = other.vm_exits_debug;
-		vm_exits_cov      = other.vm_exits_cov;
-		total_cycles      = other.total_cycles;
-		reset_cycles      = other.reset_cycles;
-		reset_pages       = other.reset_pages;
-		run_cycles        = other.run_cycles;
-		hypercall_cycles  = other.hypercall_cycles;
-		kvm_cycles        = other.kvm_cycles;
-		mut_cycles        = other.mut_cycles;
-		mut1_cycles       = other.mut1_cycles;
-		mut2_cycles       = other.mut2_cycles;
-		set_input_cycles  = other.set_input_cycles;
-		update_cov_cycles = other.update_cov_cycles;
-		report_cov_cycles = other.report_cov_cycles;
-	}
+#define X(type, name) type name {0};
+	STATS_COUNTERS(X)
+#undef X
+#define X(name) Histogram name;
+	STATS_HISTOGRAMS(X)
+#undef X
 
-	void update(const Stats& stats){
-		while (lock.test_and_set());
-		cases             += stats.cases;
-		instr             += stats.instr;
-		crashes           += stats.crashes;
-		timeouts          += stats.timeouts;
-		vm_exits          += stats.vm_exits;
-		vm_exits_hc       += stats.vm_exits_hc;
-		vm_exits_debug    += stats.vm_exits_debug;
-		vm_exits_cov      += stats.vm_exits_cov;
-		total_cycles      += stats.total_cycles;
-		reset_cycles      += stats.reset_cycles;
-		reset_pages       += stats.reset_pages;
-		run_cycles        += stats.run_cycles;
-		hypercall_cycles  += stats.hypercall_cycles;
-		kvm_cycles        += stats.kvm_cycles;
-		mut_cycles        += stats.mut_cycles;
-		mut1_cycles       += stats.mut1_cycles;
-		mut2_cycles       += stats.mut2_cycles;
-		set_input_cycles  += stats.set_input_cycles;
-		update_cov_cycles += stats.update_cov_cycles;
-		report_cov_cycles += stats.report_cov_cycles;
-		lock.clear();
-	}
+	// VM exits by reason, hypercall and debug rip
+	ExitProfile exits;
+
+	// Syscalls handled by the guest kernel
+	SyscallProfile syscalls;
 };
 
+// Stats of every worker. Each worker accumulates its stats in its own Stats,
+// and publishes them from time to time to its slot, which only that worker
+// writes. Slots are aligned to cache lines so workers don't share them.
+// Counters are written and read with relaxed atomic stores and loads, which
+// are plain moves, so neither publishing nor summing need locks or atomic
+// read-modify-write instructions.
+class SharedStats {
+public:
+	SharedStats(int nthreads);
+	~SharedStats();
+
+	SharedStats(const SharedStats&) = delete;
+	SharedStats& operator=(const SharedStats&) = delete;
+
+	// Publish the stats of worker `id`, which must include every previously
+	// published stat
+	void publish(int id, const Stats& stats);
+
+	// Stats published by worker `id`
+	Stats worker(int id) const;
+
+	// Sum of the stats published by every worker
+	Stats sum() const;
+
+	// Exit profiles published by every worker. Intervals must be computed
+	// per worker with ExitProfile::add_interval, not from sums.
+	std::vector<ExitProfile> exits() const;
+
+	int nthreads() const;
+
+private:
+	struct alignas(64) Slot {
+		Stats stats;
+	};
+
+	int m_nthreads;
+	Slot* m_slots;
+};
+
+inline SharedStats::SharedStats(int nthreads)
+	: m_nthreads(nthreads)
+{
+	// new doesn't honor the alignment of Slot
+	void* p;
+	int ret = posix_memalign(&p, alignof(Slot), nthreads*sizeof(Slot));
+	if (ret != 0)
+		abort();
+	m_slots = (Slot*)p;
+	for (int i = 0; i < nthreads; i++)
+		new (&m_slots[i]) Slot();
+}
+
+inline SharedStats::~SharedStats() {
+	free(m_slots);
+}
+
+inline void SharedStats::publish(int id, const Stats& stats) {
+	Stats& slot = m_slots[id].stats;
+#define X(type, name) \
+	__atomic_store_n(&slot.name, stats.name, __ATOMIC_RELAXED);
+	STATS_COUNTERS(X)
+#undef X
+#define X(name) slot.name.store_relaxed(stats.name);
+	STATS_HISTOGRAMS(X)
+#undef X
+	slot.exits.store_relaxed(stats.exits);
+	slot.syscalls.store_relaxed(stats.syscalls);
+}
+
+inline Stats SharedStats::worker(int id) const {
+	Stats stats;
+	const Stats& slot = m_slots[id].stats;
+#define X(type, name) \
+	stats.name = __atomic_load_n(&slot.name, __ATOMIC_RELAXED);
+	STATS_COUNTERS(X)
+#undef X
+#define X(name) stats.name.add_relaxed(slot.name);
+	STATS_HISTOGRAMS(X)
+#undef X
+	stats.exits.add_relaxed(slot.exits);
+	stats.syscalls.add_relaxed(slot.syscalls);
+	return stats;
+}
+
+inline Stats SharedStats::sum() const {
+	Stats total;
+	for (int i = 0; i < m_nthreads; i++) {
+		const Stats& slot = m_slots[i].stats;
+#define X(type, name) \
+		total.name += __atomic_load_n(&slot.name, __ATOMIC_RELAXED);
+		STATS_COUNTERS(X)
+#undef X
+#define X(name) total.name.add_relaxed(slot.name);
+		STATS_HISTOGRAMS(X)
+#undef X
+		total.exits.add_relaxed(slot.exits);
+		total.syscalls.add_relaxed(slot.syscalls);
+	}
+	return total;
+}
+
+inline std::vector<ExitProfile> SharedStats::exits() const {
+	std::vector<ExitProfile> exits(m_nthreads);
+	for (int i = 0; i < m_nthreads; i++)
+		exits[i].add_relaxed(m_slots[i].stats.exits);
+	return exits;
+}
+
+inline int SharedStats::nthreads() const {
+	return m_nthreads;
+}
+
 #if TIMETRACE == 0
 #define rdtsc1() (0)
 #define rdtsc2() (0)
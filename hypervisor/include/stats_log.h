@@ -0,0 +1,49 @@
+#ifndef _STATS_LOG_H
+#define _STATS_LOG_H
+
+#include <cstdio>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "stats.h"
+
+class Corpus;
+
+// Time series of the stats, written as JSON lines so it can be processed by
+// scripts. Each line is an object with:
+// - time: seconds since the log was created.
+// - corpus: size, coverage, memory and crashes of the corpus.
+// - total: every counter summed over all workers, cumulative.
+// - hist: p50/p99/p999/max of every histogram during the last interval.
+// - exits, hypercalls: count and cycles of each exit reason and hypercall
+//   during the last interval, and debug_rips: the rips with the most debug
+//   exits during the last interval.
+// - syscalls: count and cycles of each syscall handled by the guest kernel
+//   during the last interval.
+// - workers: per-worker cases, fcps, reset pages and vm exits, the last three
+//   during the last interval, so a slow worker can be told apart.
+class StatsLog {
+public:
+	StatsLog(const std::string& path, int nthreads);
+	~StatsLog();
+
+	StatsLog(const StatsLog&) = delete;
+	StatsLog& operator=(const StatsLog&) = delete;
+
+	// Write a line with the current stats
+	void write(const SharedStats& shared_stats, const Corpus& corpus);
+
+private:
+	static const size_t TOP_RIPS = 10;
+
+	FILE* m_file;
+	std::chrono::steady_clock::time_point m_start;
+	std::chrono::steady_clock::time_point m_last_time;
+
+	// Stats when the last line was written, for computing intervals
+	Stats m_total_old;
+	std::vector<Stats> m_workers_old;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _TRIMMER_H
+#define _TRIMMER_H
+
+#include <string>
+#include "vm.h"
+
+// Trims inputs that found new coverage before they are added to the corpus,
+// as AFL does. It removes chunks of decreasing size from the input, keeping
+// the removal each time the coverage stays the same. Runs are performed in its
+// own copy of the base vm, where breakpoints dirty memory so every run gets
+// the full coverage of the input, and not just the new one.
+class Trimmer {
+public:
+	// Inputs smaller than this are not trimmed
+	static const size_t MIN_INPUT_SIZE = 5;
+
+	// Chunks start at 1/16 of the input size, and they are halved until they
+	// reach 1/1024 of the input size or MIN_CHUNK_SIZE
+	static const size_t START_STEPS = 16;
+	static const size_t END_STEPS = 1024;
+	static const size_t MIN_CHUNK_SIZE = 4;
+
+	Trimmer(const Vm& base, size_t max_input_size);
+
+	// Trim `input` in place. Set `cov` and `read_info` to the coverage and the
+	// parts of the input read by the trimmed input. Return the number of runs.
+	size_t trim(std::string& input, Coverage& cov, InputReadInfo& read_info);
+
+private:
+	const Vm& m_base;
+	Vm m_vm;
+
+	// Candidate input, with capacity for the max input size
+	std::string m_candidate;
+
+	// Stats of trimming runs, which we don't want to mix with the others
+	Stats m_stats;
+
+	Vm::RunEndReason run(const std::string& input);
+};
+
+#endif
@@ -6,10 +6,15 @@ std::string read_file(const std::string& filepath);
 
 void write_file(const std::string& filepath, const std::string& content);
 
+void write_file(const std::string& filepath, const char* data, size_t size);
+
 std::string md5(const std::string& s);
 
 std::string md5(const uint8_t* buf, size_t length);
 
 std::string md5_file(const std::string& filepath);
 
-std::string to_hex(size_t num);
\ No newline at end of file
+std::string to_hex(size_t num);
+
+// Name of the Linux x86_64 syscall number `nr`
+const char* syscall_str(size_t nr);
\ No newline at end of file
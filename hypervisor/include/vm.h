@@ -9,6 +9,7 @@
 #include "common.h"
 #include "kvm_aux.h"
 #include "fault.h"
+#include "input_read_info.h"
 #include "coverage.h"
 #ifdef ENABLE_COVERAGE_INTEL_PT
 #include <libxdc.h>
@@ -23,9 +24,61 @@ struct file_t {
 	vaddr_t guest_length_addr;
 };
 
+// Snapshot of a VM in the middle of a run, taken right before the guest
+// kernel hands input bytes that haven't been read yet to the user. It holds
+// only the pages dirtied since the VM was last reset, so it can only be
+// restored into a VM which is a copy of the same base VM.
+struct Snapshot {
+	kvm_regs  regs;
+	kvm_sregs sregs;
+	std::vector<paddr_t> pages;
+	std::vector<uint8_t> memory;
+
+	// State that isn't in the registers or in memory: FPU and extended
+	// registers as a kvm_xsave, MSRs given by Vm::SNAPSHOT_MSRS, and the LAPIC
+	// with its timer
+	std::vector<uint8_t> xsave;
+	kvm_lapic_state lapic;
+	std::vector<kvm_msr_entry> msrs;
+
+	// Input bytes read by the guest before the snapshot, and total input
+	// size, which the guest may have observed. The snapshot is valid for any
+	// input of the same size starting with the same prefix.
+	std::string input_prefix;
+	size_t input_size;
+
+	// Cycles and user instructions the run took until the snapshot, which
+	// runs resumed from it skip
+	cycle_t  prefix_cycles;
+	uint64_t prefix_instructions;
+
+	// Approximate memory used by the snapshot
+	size_t memsize() const;
+
+	// Check if the state of the snapshot could have been reached running
+	// `input`
+	bool valid_for(const std::string& input) const;
+};
+
+// Values of the guest performance counters, which are never reset, or their
+// increment during a run
+// Keep this the same as in the kernel
+struct PerfCounters {
+	uint64_t user_instructions;
+	uint64_t kernel_instructions;
+	uint64_t user_cycles;
+	uint64_t kernel_cycles;
+};
+
 class Vm {
 public:
 	static const char* reason_str[];
+
+	// Name of hypercall number `n`
+	static const char* hypercall_str(size_t n);
+
+	// MSRs saved in snapshots
+	static const std::vector<uint32_t> SNAPSHOT_MSRS;
 	enum RunEndReason {
 		Exit,
 		Debug,
@@ -54,10 +107,42 @@ public:
 	kvm_regs regs() const;
 	Mmu& mmu();
 	ElfParser& elf();
+
+	// Kernel, binary, interpreter, if any, and libraries found by
+	// `load_libraries`
+	std::vector<const ElfParser*> elfs() const;
+
+	// Find the libraries loaded by the dynamic linker in the guest, walking
+	// its list of loaded objects. Only libraries set as files are found.
+	void load_libraries();
+
+	// Write the function symbols of every elf at their load addresses, so
+	// host profilers can symbolize guest rips. `path`.map is in perf map
+	// format, which perf reads from /tmp/perf-<pid>.map, and `path`.kallsyms
+	// is in /proc/kallsyms format, for `perf kvm --guestkallsyms`.
+	void write_symbol_maps(const std::string& path) const;
 	psize_t memsize() const;
 	FaultInfo fault() const;
 	uint64_t instructions_executed_last_run() const;
 
+	// Instructions and cycles in user and kernel mode in last run
+	PerfCounters perf_counters_last_run() const;
+
+	// Parts of the input read by the guest in last run
+	const InputReadInfo& input_read_info() const;
+
+	// Syscalls handled by the guest kernel since this Vm was created
+	const SyscallProfile& syscall_profile() const;
+
+	// Set the number of cycles between samples of the guest rip, or 0 to
+	// disable sampling. It must be lower than 2^31, and it must be set before
+	// the first run, as the kernel reads it when it starts.
+	void set_sample_interval(uint64_t cycles);
+
+	// Append the rips sampled since the last call to `rips`, and return the
+	// number of samples that were overwritten before being read
+	uint64_t pop_samples(std::vector<vaddr_t>& rips);
+
 #if defined(ENABLE_COVERAGE_INTEL_PT)
 	void setup_coverage();
 #elif defined(ENABLE_COVERAGE_BREAKPOINTS)
@@ -73,6 +158,20 @@ public:
 
 	void set_input(const std::string& input);
 
+	// Ask the guest kernel to stop right before the input byte at `offset` is
+	// read for the first time in next run, and take a snapshot at that point.
+	// It does nothing if the kernel doesn't support it. Breakpoints must not
+	// dirty memory, or the snapshot could contain breakpoints that don't
+	// exist anymore.
+	void request_snapshot(size_t offset);
+
+	// Move the snapshot taken in last run, if any, into `snapshot`
+	bool pop_snapshot(Snapshot& snapshot);
+
+	// Restore a snapshot right after a reset, so next run resumes from that
+	// point. Input must be set again after this.
+	void restore_snapshot(const Snapshot& snapshot);
+
 	RunEndReason run(Stats& stats);
 
 	void run_until(vaddr_t pc, Stats& stats);
@@ -126,6 +225,7 @@ private:
 	ElfParser  m_elf;
 	ElfParser  m_kernel;
 	ElfParser* m_interpreter;
+	std::vector<ElfParser> m_libraries;
 	std::vector<std::string> m_argv;
 	Mmu  m_mmu;
 	bool m_running;
@@ -142,16 +242,32 @@ private:
 
 	FaultInfo m_fault;
 
-	// Instructions executed until last run and until previous run.
+	InputReadInfo m_input_read_info;
+
+	// Performance counters at the end of last run and of previous run.
 	// They are updated when guest uses hypercall EndRun or Fault.
-	uint64_t m_instructions_executed;
-	uint64_t m_instructions_executed_prev;
+	PerfCounters m_perf_counters;
+	PerfCounters m_perf_counters_prev;
+
+	// Timestamp of the start of the current run
+	cycle_t m_run_start;
+
+	// Cycles between rip samples, given to the kernel with hypercall
+	// GetInfo, and number of samples read from the ring in shared memory
+	uint64_t m_sample_interval;
+	uint64_t m_samples_tail;
 
 	// Addresses of the timer and timeout value inside the VM. These are
 	// submitted by the kernel using `hc_set_timeout_pointers`.
 	vaddr_t m_timer_addr;
 	vaddr_t m_timeout_addr;
 
+	// Address of the snapshot offset inside the VM, submitted by the kernel
+	// using `hc_submit_snapshot_pointer`, and snapshot taken in current run
+	vaddr_t  m_snapshot_offset_addr;
+	Snapshot m_snapshot;
+	bool     m_snapshot_taken;
+
 	// This is just for debugging
 	std::vector<vaddr_t> m_allocations;
 
@@ -164,7 +280,7 @@ private:
 	void setup_kernel_execution();
 	void set_regs_dirty();
 	void set_sregs_dirty();
-	void set_instructions_executed(uint64_t instr_executed);
+	void set_perf_counters(const PerfCounters& counters);
 	void* fetch_page(uint64_t page, bool* success);
 	uint8_t set_breakpoint_to_memory(vaddr_t addr);
 	void remove_breakpoint_from_memory(vaddr_t addr, uint8_t original_byte);
@@ -187,7 +303,10 @@ private:
 	void do_hc_submit_timeout_pointers(vaddr_t timer_addr, vaddr_t timeout_addr);
 	void do_hc_print_stacktrace(vaddr_t rsp, vaddr_t rip, vaddr_t rbp);
 	void do_hc_end_run(RunEndReason reason, vaddr_t info_addr,
-	                   uint64_t instructions_executed);
+	                   uint64_t instructions_executed,
+	                   vaddr_t end_run_info_addr);
+	void do_hc_submit_snapshot_pointer(vaddr_t snapshot_offset_addr);
+	void do_hc_snapshot_point(size_t input_consumed);
 
 	/* void handle_syscall();
 	*/
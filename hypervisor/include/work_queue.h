@@ -0,0 +1,107 @@
+#ifndef _WORK_QUEUE_H
+#define _WORK_QUEUE_H
+
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "common.h"
+
+// Queue of the indexes from 0 to n-1 shared by several threads, with work
+// stealing. Each thread starts with a contiguous range of indexes, and takes
+// them from the front. When its range is empty, it steals the back half of the
+// range of another thread. Each range is a single atomic word, so no locking
+// is needed.
+class WorkQueue {
+public:
+	WorkQueue(int nthreads, size_t n);
+
+	// Get the next index for thread `id`. Return false when there are no
+	// indexes left.
+	bool pop(int id, size_t& i);
+
+private:
+	// Ranges are packed as begin << 32 | end
+	int m_nthreads;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_ranges;
+
+	static uint64_t pack(size_t begin, size_t end);
+	static size_t begin(uint64_t range);
+	static size_t end(uint64_t range);
+};
+
+// Call `f(i)` for every i from 0 to n-1 using `nthreads` threads
+template <class F>
+void parallel_for(int nthreads, size_t n, F f);
+
+
+inline WorkQueue::WorkQueue(int nthreads, size_t n)
+	: m_nthreads(nthreads)
+	, m_ranges(new std::atomic<uint64_t>[nthreads])
+{
+	ASSERT(n < (1UL << 32), "too many indexes: %lu", n);
+	for (int id = 0; id < nthreads; id++)
+		m_ranges[id] = pack(n*id / nthreads, n*(id + 1) / nthreads);
+}
+
+inline uint64_t WorkQueue::pack(size_t begin, size_t end) {
+	return (begin << 32) | end;
+}
+
+inline size_t WorkQueue::begin(uint64_t range) {
+	return range >> 32;
+}
+
+inline size_t WorkQueue::end(uint64_t range) {
+	return range & 0xFFFFFFFF;
+}
+
+inline bool WorkQueue::pop(int id, size_t& i) {
+	// Take the first index of our range. Other threads may be stealing from
+	// it at the same time
+	uint64_t range = m_ranges[id].load();
+	while (begin(range) < end(range)) {
+		if (m_ranges[id].compare_exchange_weak(range,
+		                                       pack(begin(range) + 1, end(range))))
+		{
+			i = begin(range);
+			return true;
+		}
+	}
+
+	// Our range is empty. Steal the back half of the range of the first
+	// thread that has work left, take its first index and keep the rest as
+	// our range. Nobody steals from an empty range, so we can just store it.
+	for (int j = 1; j < m_nthreads; j++) {
+		std::atomic<uint64_t>& victim = m_ranges[(id + j) % m_nthreads];
+		range = victim.load();
+		while (begin(range) < end(range)) {
+			size_t mid = begin(range) + (end(range) - begin(range))/2;
+			if (victim.compare_exchange_weak(range, pack(begin(range), mid))) {
+				i = mid;
+				m_ranges[id].store(pack(mid + 1, end(range)));
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+template <class F>
+void parallel_for(int nthreads, size_t n, F f) {
+	nthreads = std::max(1, std::min(nthreads, (int)n));
+	WorkQueue queue(nthreads, n);
+	std::vector<std::thread> threads;
+	for (int id = 0; id < nthreads; id++) {
+		threads.push_back(std::thread([&queue, &f, id]() {
+			size_t i;
+			while (queue.pop(id, i))
+				f(i);
+		}));
+	}
+	for (std::thread& t : threads)
+		t.join();
+}
+
+#endif
@@ -7,6 +7,7 @@
  */
 
 #include <thread>
+#include <random>
 #include <fstream>
 #include <sstream>
 #include "args.h"
@@ -49,8 +50,14 @@ bool Args::parse(int argc, char** argv) {
 			("j,jobs", "Number of threads to use", cxxopts::value<int>(jobs)->default_value(to_string(DEFAULT_NUM_THREADS)), "n")
 			("m,memory", "Virtual machine memory limit", cxxopts::value<string>()->default_value("8M"))
 			("t,timeout", "Timeout for each in run in milliseconds, or 0 for no timeout", cxxopts::value<size_t>(timeout)->default_value("2"), "ms")
+			("snapshot-cache", "Memory limit for the snapshots of hot inputs of all threads, or 0 to disable them", cxxopts::value<string>()->default_value("512M"))
+			("stats-interval", "Interval for writing stats to stats.jsonl in the output folder, or 0 to disable it", cxxopts::value<size_t>(stats_interval)->default_value("5"), "secs")
+			("sample-interval", "Cycles between samples of the guest rip, written to samples.folded in the output folder, or 0 to disable sampling", cxxopts::value<uint64_t>(sample_interval)->default_value("0"), "cycles")
+			("seed", "Seed for the random number generators, or 0 to use a random one", cxxopts::value<uint64_t>(seed)->default_value("0"))
+			("schedule", "Power schedule for choosing inputs to mutate: explore, fast or rare", cxxopts::value<string>()->default_value("fast"), "name")
+			("no-trim", "Don't trim inputs with new coverage before adding them to the corpus", cxxopts::value<bool>(no_trim))
 			("k,kernel", "Kernel path", cxxopts::value<string>(kernel_path)->default_value("./kernel/kernel"), "path")
-			("i,input", "Input folder (initial corpus)", cxxopts::value<string>(input_dir)->default_value("./in"), "dir")
+			("i,input", "Input folder (initial corpus), or - to resume the campaign in the output folder", cxxopts::value<string>(input_dir)->default_value("./in"), "dir")
 			("o,output", "Output folder (corpus, crashes, etc)", cxxopts::value<string>(output_dir)->default_value("./out"), "dir")
 			("f,file", "Memory loaded files for the target. Set once for each file, or as a list: -f file1,file2", cxxopts::value<vector<string>>(memory_files), "path")
 			("b,basic-blocks", "Path to file containing a list of basic blocks for code coverage. Default value is basic_blocks_<BinaryMD5Hash>.txt", cxxopts::value<string>(basic_blocks_path), "path")
@@ -80,6 +87,10 @@ bool Args::parse(int argc, char** argv) {
 
 		// Parse special arguments
 		memory = parse_memory(options["memory"].as<string>());
+		snapshot_cache = parse_memory(options["snapshot-cache"].as<string>());
+		string schedule_name = options["schedule"].as<string>();
+		if (!Scheduler::parse_schedule(schedule_name, schedule))
+			throw cxxopts::OptionParseException("invalid schedule: " + schedule_name);
 
 		// Add binary path to argv
 		binary_argv.insert(binary_argv.begin(), binary_path);
@@ -100,12 +111,23 @@ bool Args::parse(int argc, char** argv) {
 			single_run = false;
 		}
 
+		// Choose a random seed if none was given. It is printed at startup, so
+		// the run can be repeated
+		if (seed == 0) {
+			random_device rd;
+			seed = ((uint64_t)rd() << 32) | rd();
+		}
+
 		// Convert timeout to microsecs, or set it to maximum value if it was 0
 		if (timeout == 0)
 			timeout = numeric_limits<size_t>::max();
 		else
 			timeout *= 1000;
 
+		// The guest counts cycles between samples with a 32 bits counter
+		if (sample_interval >= (1ULL << 31))
+			throw cxxopts::OptionParseException("sample interval too big");
+
 	} catch (cxxopts::OptionException& e) {
 		cout << "error: " << e.what() << endl;
 		return false;
@@ -0,0 +1,112 @@
+#include <chrono>
+#include <fcntl.h>
+#include "async_writer.h"
+#include "utils.h"
+
+using namespace std;
+
+AsyncWriter::AsyncWriter(const string& dir)
+	: m_tail(new Request())
+	, m_pushed(0)
+	, m_done(0)
+	, m_stop(false)
+{
+	m_head = m_tail;
+	m_head->next = nullptr;
+	m_dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+	ERROR_ON(m_dir_fd == -1, "opening dir %s", dir.c_str());
+	m_thread = thread(&AsyncWriter::writer_thread, this);
+}
+
+AsyncWriter::~AsyncWriter() {
+	flush();
+	m_stop = true;
+	m_thread.join();
+	syncfs(m_dir_fd);
+	close(m_dir_fd);
+	delete m_head;
+}
+
+void AsyncWriter::push(Request* request) {
+	// Make the request the new tail, and then link the previous one to it.
+	// The writer thread stops at the previous one until it's linked.
+	request->next.store(nullptr, memory_order_relaxed);
+	m_pushed++;
+	Request* prev = m_tail.exchange(request, memory_order_acq_rel);
+	prev->next.store(request, memory_order_release);
+}
+
+AsyncWriter::Request* AsyncWriter::pop() {
+	Request* next = m_head->next.load(memory_order_acquire);
+	if (!next)
+		return nullptr;
+	delete m_head;
+	m_head = next;
+	return next;
+}
+
+void AsyncWriter::write_file(const string& path, const string& data) {
+	Request* request = new Request();
+	request->path = path;
+	request->owned_data = data;
+	request->data = InputRef(request->owned_data.data(),
+	                         request->owned_data.size());
+	push(request);
+}
+
+void AsyncWriter::write_file(const string& path, const InputRef& input) {
+	Request* request = new Request();
+	request->path = path;
+	request->data = input;
+	push(request);
+}
+
+void AsyncWriter::run(const function<void()>& task) {
+	Request* request = new Request();
+	request->task = task;
+	push(request);
+}
+
+void AsyncWriter::flush() {
+	size_t pushed = m_pushed;
+	while (m_done < pushed)
+		this_thread::sleep_for(chrono::milliseconds(1));
+}
+
+void AsyncWriter::perform(Request& request) {
+	if (request.task) {
+		request.task();
+		request.task = nullptr;
+	} else {
+		::write_file(request.path, request.data.data(), request.data.size());
+		request.path.clear();
+		request.owned_data.clear();
+		request.owned_data.shrink_to_fit();
+	}
+}
+
+void AsyncWriter::writer_thread() {
+	const chrono::milliseconds IDLE_TIME {IDLE_TIME_MS};
+	const chrono::milliseconds SYNC_TIME {SYNC_TIME_MS};
+	chrono::steady_clock::time_point last_sync = chrono::steady_clock::now();
+	bool written = false;
+	while (!m_stop) {
+		// Perform every request in the queue
+		Request* request;
+		while ((request = pop())) {
+			perform(*request);
+			m_done++;
+			written = true;
+		}
+
+		// Sync if there were writes since last time
+		auto now = chrono::steady_clock::now();
+		if (written && now - last_sync >= SYNC_TIME) {
+			ERROR_ON(syncfs(m_dir_fd) == -1, "syncfs");
+			last_sync = now;
+			written = false;
+		}
+
+		this_thread::sleep_for(IDLE_TIME);
+	}
+}
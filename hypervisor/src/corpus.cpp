@@ -6,25 +6,59 @@
 #include "corpus.h"
 #include "magic_values.h"
 #include "utils.h"
+#include "hash.h"
+#include "work_queue.h"
 
 using namespace std;
 
-Corpus::Corpus(int nthreads, const string& input_dir, const string& output_dir)
+Corpus::Corpus(int nthreads, const string& input_dir, const string& output_dir,
+               Scheduler::Schedule schedule)
 	: m_input_dir(input_dir)
 	, m_output_dir_corpus(output_dir + "/" + CORPUS_DIR)
 	, m_output_dir_crashes(output_dir + "/" + CRASHES_DIR)
 	, m_output_dir_min_corpus(output_dir + "/" + MIN_CORPUS_DIR)
 	, m_output_dir_min_crashes(output_dir + "/" + MIN_CRASHES_DIR)
+	, m_pack_path(output_dir + "/" + PACK_FILE)
+	, m_checkpoint_path(output_dir + "/" + CHECKPOINT_FILE)
 	, m_lock_corpus(false)
+	, m_resumed(false)
+	, m_crash_buckets(0)
 	, m_lock_crashes(false)
+	, m_seen_paths(nthreads, vector<uint64_t>(SEEN_PATHS_SIZE))
 	, m_mutated_inputs(nthreads)
+	, m_mutated_inputs_read_infos(nthreads)
+	, m_seen_inputs(nthreads, DecayingBloomFilter(SEEN_INPUTS_CAPACITY))
+	, m_scheduler(nthreads, schedule)
 	, m_mutated_inputs_indexes(nthreads)
 	, m_mode(Mode::Unknown)
 {
-	// Reuse corpus as input
-	if (m_input_dir == "-")
+	// Reuse corpus as input. If the previous campaign left a pack, resume
+	// from it
+	if (m_input_dir == "-") {
 		m_input_dir = m_output_dir_corpus;
+		m_resumed = PackFile::exists(m_pack_path);
+	}
+
+	if (m_resumed)
+		read_pack();
+	else
+		read_input_dir();
+
+	// Reserve memory for the mutated inputs, so mutations never reallocate
+	for (string& mutated_input : m_mutated_inputs)
+		mutated_input.reserve(m_max_input_size);
+
+	cout << "Max mutated input size: " << m_max_input_size << endl;
+
+	// Create output directory (or do nothing if they existed).
+	// Each mode we'll create the subdirectory they'll write their output to
+	// here. Normal mode will write corpus and crashes dir, while each
+	// minimization mode will write to its own directory.
+	create_folder(output_dir);
+	m_writer.reset(new AsyncWriter(output_dir));
+}
 
+void Corpus::read_input_dir() {
 	// Try to open input directory
 	DIR* dir = opendir(m_input_dir.c_str());
 	ERROR_ON(!dir, "opening input directory %s", m_input_dir.c_str());
@@ -48,7 +82,8 @@ Corpus::Corpus(int nthreads, const string& input_dir, const string& output_dir)
 		// For each regular file, add its content to the corpus and save
 		// its filename
 		input = read_file(filepath);
-		m_corpus.push_back(input);
+		m_corpus.push_back({ m_storage.store(input),
+		                     InputReadInfo::whole(input.size()) });
 		m_seeds_filenames.push_back(ent->d_name);
 
 		// Record the size of the largest initial file
@@ -68,13 +103,24 @@ Corpus::Corpus(int nthreads, const string& input_dir, const string& output_dir)
 
 	ASSERT(m_corpus.size() != 0, "empty corpus: %s", m_input_dir.c_str());
 	cout << "Total files read: " << m_corpus.size() << endl;
-	cout << "Max mutated input size: " << m_max_input_size << endl;
+}
 
-	// Create output directory (or do nothing if they existed).
-	// Each mode we'll create the subdirectory they'll write their output to
-	// here. Normal mode will write corpus and crashes dir, while each
-	// minimization mode will write to its own directory.
-	create_folder(output_dir);
+void Corpus::read_pack() {
+	// Inputs are used from the mapped pack without copying them. We keep
+	// the max input size of the first campaign, instead of deriving it from
+	// inputs that may have already grown.
+	m_pack.reset(new PackFile(m_pack_path));
+	for (size_t i = 0; i < m_pack->mapped_size(); i++) {
+		InputRef input = m_pack->input(i);
+		m_corpus.push_back({ m_storage.adopt(input.data(), input.size()),
+		                     m_pack->record(i).read_info });
+		m_seeds_filenames.push_back(corpus_filename(i));
+	}
+	m_max_input_size = m_pack->max_input_size();
+
+	ASSERT(m_corpus.size() != 0, "empty pack: %s", m_pack_path.c_str());
+	cout << "Total inputs read from pack " << m_pack_path << ": "
+	     << m_corpus.size() << endl;
 }
 
 size_t Corpus::size() const {
@@ -82,10 +128,7 @@ size_t Corpus::size() const {
 }
 
 size_t Corpus::memsize() const {
-	size_t size = 0;
-	for (const string& s : m_corpus)
-		size += s.size();
-	return size;
+	return m_storage.memsize();
 }
 
 size_t Corpus::max_input_size() const {
@@ -96,20 +139,36 @@ size_t Corpus::unique_crashes() const {
 	return m_crashes.size();
 }
 
+size_t Corpus::crash_buckets() const {
+	return m_crash_buckets;
+}
+
 size_t Corpus::coverage() const {
 	return m_recorded_coverage.count();
 }
 
+size_t Corpus::favored() const {
+	return m_scheduler.favored();
+}
+
 string Corpus::seed_filename(size_t i) const {
 	ASSERT(i < m_seeds_filenames.size(), "OOB i: %lu", i);
 	return m_seeds_filenames[i];
 }
 
-const string& Corpus::element(size_t i) const {
+InputRef Corpus::element(size_t i) const {
 	ASSERT(i < m_corpus.size(), "OOB i: %lu", i);
+	return m_corpus[i].data;
+}
+
+const Corpus::Entry& Corpus::entry(size_t i) const {
 	return m_corpus[i];
 }
 
+bool Corpus::resumed() const {
+	return m_resumed;
+}
+
 string Corpus::corpus_filename(size_t i) {
 	return "id" + to_string(i);
 }
@@ -124,36 +183,73 @@ string Corpus::min_crash_filename(size_t i) {
 
 void Corpus::write_corpus_file(size_t i) {
 	ASSERT(m_mode == Mode::Normal, "mode %d", m_mode);
-	write_file(m_output_dir_corpus + "/" + corpus_filename(i), m_corpus[i]);
+	m_writer->write_file(m_output_dir_corpus + "/" + corpus_filename(i),
+	                     m_corpus[i].data);
 }
 
 void Corpus::write_crash_file(size_t i, const FaultInfo& fault) {
 	ASSERT(m_mode == Mode::Normal, "mode %d", m_mode);
-	write_file(m_output_dir_crashes + "/" + fault.filename(), m_corpus[i]);
+	m_writer->write_file(m_output_dir_crashes + "/" + fault.filename(),
+	                     m_corpus[i].data);
 }
 
-void Corpus::write_crash_file(int id, const FaultInfo& fault) {
+void Corpus::write_crash_file(int id, const FaultInfo& fault, uint64_t path,
+                              bool first_path)
+{
 	ASSERT(m_mode == Mode::Normal, "mode %d", m_mode);
-	write_file(m_output_dir_crashes + "/" + fault.filename(),
-	           m_mutated_inputs[id]);
+	string filename = fault.filename();
+	if (!first_path)
+		filename += "_path" + to_hex(path);
+	m_writer->write_file(m_output_dir_crashes + "/" + filename,
+	                     m_mutated_inputs[id]);
 }
 
 void Corpus::write_min_corpus_file(size_t i) {
 	ASSERT(m_mode == Mode::CorpusMinimization, "mode %d", m_mode);
-	write_file(m_output_dir_min_corpus+ "/" + min_corpus_filename(i),
-	           m_corpus[i]);
+	m_writer->write_file(m_output_dir_min_corpus + "/" + min_corpus_filename(i),
+	                     m_corpus[i].data);
 }
 
 void Corpus::write_min_crash_file(size_t i) {
 	ASSERT(m_mode == Mode::CrashesMinimization, "mode %d", m_mode);
-	write_file(m_output_dir_min_crashes + "/" + min_crash_filename(i),
-	           m_corpus[i]);
+	m_writer->write_file(m_output_dir_min_crashes + "/" + min_crash_filename(i),
+	                     m_corpus[i].data);
 }
 
-void Corpus::set_mode_normal(const Coverage& total_coverage) {
+void Corpus::set_mode_normal(const vector<Coverage>& coverages,
+                             const vector<InputReadInfo>& read_infos,
+                             const vector<ExecInfo>& exec_infos)
+{
 	ASSERT(m_mode == Mode::Unknown, "corpus mode already set to %d", m_mode);
+	ASSERT(coverages.size() == m_corpus.size(), "size mismatch: %lu vs %lu",
+	       coverages.size(), m_corpus.size());
+	ASSERT(read_infos.size() == m_corpus.size(), "size mismatch: %lu vs %lu",
+	       read_infos.size(), m_corpus.size());
+	ASSERT(exec_infos.size() == m_corpus.size(), "size mismatch: %lu vs %lu",
+	       exec_infos.size(), m_corpus.size());
+	ASSERT(!m_resumed, "resumed corpus must use set_mode_normal_resumed");
 	m_mode = Mode::Normal;
-	m_recorded_coverage = total_coverage;
+
+	// Save the parts of each seed that were read, and register seeds in the
+	// scheduler and in a new pack with depth 0
+	m_pack.reset(new PackFile(m_pack_path, m_max_input_size));
+	vector<Entry> entries;
+	vector<uint64_t> keys;
+	for (size_t i = 0; i < m_corpus.size(); i++) {
+		const InputRef& input = m_corpus[i].data;
+		uint64_t path = coverages[i].fingerprint();
+		m_recorded_coverage.add(coverages[i]);
+		m_corpus_paths.insert(path);
+		entries.push_back({ input, read_infos[i] });
+		keys.clear();
+		coverages[i].collect(keys);
+		m_scheduler.add_entry(i, input.size(), exec_infos[i], 0, keys);
+		m_pack->append(input.data(), input.size(), keys, path, 0,
+		               exec_infos[i], read_infos[i]);
+		m_pack_coverage.restore(keys.data(), keys.size());
+	}
+	set_corpus(entries);
+	m_scheduler.update();
 	cout << "Set corpus mode: Normal. Output directories will be "
 	     << m_output_dir_corpus << " and " << m_output_dir_crashes
 	     << ". Seed corpus coverage: " << coverage() << endl;
@@ -170,6 +266,40 @@ void Corpus::set_mode_normal(const Coverage& total_coverage) {
 	}
 }
 
+void Corpus::set_mode_normal_resumed() {
+	ASSERT(m_mode == Mode::Unknown, "corpus mode already set to %d", m_mode);
+	ASSERT(m_resumed, "corpus wasn't read from a pack");
+	m_mode = Mode::Normal;
+
+	// Restore the coverage of the pack from the checkpoint, add the coverage
+	// of the entries that were appended after it, and record it. Register
+	// every entry in the scheduler with the metadata saved in the pack.
+	size_t checkpoint_entries = read_checkpoint();
+	size_t timeouts = 0;
+	vector<uint64_t> keys;
+	for (size_t i = 0; i < m_corpus.size(); i++) {
+		const PackFile::Record& record = m_pack->record(i);
+		const uint64_t* cov = m_pack->coverage(i);
+		if (i >= checkpoint_entries)
+			m_pack_coverage.restore(cov, record.coverage_size);
+		m_corpus_paths.insert(record.path);
+		keys.assign(cov, cov + record.coverage_size);
+		m_scheduler.add_entry(i, record.input_size, record.exec_info,
+		                      record.depth, keys);
+		timeouts += record.exec_info.timeout;
+	}
+	m_recorded_coverage.add(m_pack_coverage);
+	m_scheduler.update();
+	cout << "Set corpus mode: Normal (resumed). Output directories will be "
+	     << m_output_dir_corpus << " and " << m_output_dir_crashes
+	     << ". Resumed corpus coverage: " << coverage() << ", inputs that "
+	     << "timed out: " << timeouts << endl;
+
+	// Inputs are already in the corpus directory
+	create_folder(m_output_dir_corpus);
+	create_folder(m_output_dir_crashes);
+}
+
 void Corpus::set_mode_corpus_min(const vector<Coverage>& coverages) {
 #ifndef ENABLE_COVERAGE
 	ASSERT(false, "corpus minimization mode needs coverage");
@@ -202,7 +332,6 @@ void Corpus::set_mode_crashes_min(const vector<FaultInfo>& faults) {
 	ASSERT(faults.size() == m_corpus.size(), "size mismatch: %lu vs %lu",
 	       faults.size(), m_corpus.size());
 	m_mode = Mode::CrashesMinimization;
-	m_faults = faults;
 	cout << "Set corpus mode: Crashes Minimization. Output directory will be "
 	     << m_output_dir_min_crashes << endl;
 
@@ -218,76 +347,110 @@ const string& Corpus::get_new_input(int id, Rng& rng, Stats& stats){
 	// constant reference to it
 	ASSERT(m_mode != Mode::Unknown, "mode not set");
 	cycle_t cycles = rdtsc2();
-	while (m_lock_corpus.test_and_set());
-	size_t i = rng.rnd(0, m_corpus.size() - 1);
-	m_mutated_inputs[id] = m_corpus[i];
+	size_t i;
+	if (m_mode == Mode::Normal)
+		i = m_scheduler.choose(id, rng);
+	else
+		i = rng.rnd(0, m_corpus.size() - 1);
+	const Entry& entry = m_corpus[i];
+	string& input = m_mutated_inputs[id];
+	m_mutated_inputs_read_infos[id] = entry.read_info;
 	m_mutated_inputs_indexes[id] = i;
-	m_lock_corpus.clear();
 	stats.mut1_cycles += rdtsc2() - cycles;
 
+	// Mutate it, and try again if we have recently generated the same input.
+	// This is much cheaper than running it.
 	cycles = rdtsc2();
-	mutate_input(id, rng);
+	for (int retries = 0; retries <= MAX_DUP_RETRIES; retries++) {
+		input.assign(entry.data.data(), entry.data.size());
+		mutate_input(id, rng);
+		if (!m_seen_inputs[id].insert(hash64(input.data(), input.size())))
+			break;
+		stats.dup_inputs++;
+	}
 	stats.mut2_cycles += rdtsc2() - cycles;
-	return m_mutated_inputs[id];
+	return input;
 }
 
-void Corpus::report_crash(int id, const FaultInfo& fault) {
-	ASSERT(m_mode != Mode::Unknown, "mode not set");
-	if (m_mode == Mode::CrashesMinimization) {
-		handle_crash_crashes_minimization(id, fault);
-		return;
-	}
+size_t Corpus::mutated_input_index(int id) const {
+	return m_mutated_inputs_indexes[id];
+}
 
-	// Try to insert fault information into our set
+size_t Corpus::mutated_input_offset(int id) {
+	const string& mutated_input = m_mutated_inputs[id];
+	const InputRef& input = m_corpus[m_mutated_inputs_indexes[id]].data;
+	size_t size = min(input.size(), mutated_input.size());
+	return mismatch(input.begin(), input.begin() + size,
+	                mutated_input.begin()).first - input.begin();
+}
+
+void Corpus::report_crash(int id, const FaultInfo& fault, uint64_t path) {
+	ASSERT(m_mode != Mode::Unknown && m_mode != Mode::CrashesMinimization,
+	       "unexpected mode %d", m_mode);
+
+	// Try to insert fault information and path into our map
 	while (m_lock_crashes.test_and_set());
-	bool inserted = m_crashes.insert(fault).second;
+	unordered_set<uint64_t>& paths = m_crashes[fault];
+	bool new_fault  = paths.empty();
+	bool new_bucket = paths.insert(path).second;
 	m_lock_crashes.clear();
 
-	// If it was new, print fault information and dump input file to disk
-	if (inserted) {
-		cout << endl << fault << endl << endl;
-		// We still want to count unique crashes in corpus minimization mode,
-		// but we don't want to write to other directories.
+	// If it was a new fault, print fault information. This is done by the
+	// writer, so crashing workers don't contend on stdout
+	if (new_fault)
+		m_writer->run([fault]() { cout << endl << fault << endl << endl; });
+
+	// If it was a new bucket, dump input file to disk. We still want to count
+	// unique crashes in corpus minimization mode, but we don't want to write
+	// to other directories.
+	if (new_bucket) {
+		m_crash_buckets++;
 		if (m_mode != Mode::CorpusMinimization) {
 			//add_input(m_mutated_inputs[id]);
-			write_crash_file(id, fault);
+			write_crash_file(id, fault, path, new_fault);
 		}
 	}
 }
 
-void Corpus::handle_crash_crashes_minimization(int id, const FaultInfo& fault) {
-	// If the fault is the same as the one we're trying to minimize and
-	// the size of the mutated input is lower than current input size,
-	// replace current input with mutated input and save file to disk.
-	size_t i = m_mutated_inputs_indexes[id];
-	if (fault == m_faults[i]) {
-		const string& mutated_input = m_mutated_inputs[id];
-		while (m_lock_corpus.test_and_set());
-		if (mutated_input.size() < m_corpus[i].size()) {
-			m_corpus[i] = mutated_input;
-			write_min_crash_file(i);
-		}
-		m_lock_corpus.clear();
-	}
+void Corpus::set_minimized_crash(size_t i, const string& input) {
+	ASSERT(m_mode == Mode::CrashesMinimization, "mode %d", m_mode);
+	while (m_lock_corpus.test_and_set());
+	m_corpus.replace(i, { m_storage.store(input),
+	                      InputReadInfo::whole(input.size()) });
+	write_min_crash_file(i);
+	m_lock_corpus.clear();
 }
 
-void Corpus::report_coverage(int id, const Coverage& cov) {
-
+bool Corpus::report_coverage(int id, const Coverage& cov) {
 	switch (m_mode) {
-		case Mode::CrashesMinimization:
-			break;
 		case Mode::CorpusMinimization:
 			handle_cov_corpus_minimization(id, cov);
 			break;
-		case Mode::Normal:
-			if (m_recorded_coverage.add(cov)) {
-				// There was new coverage
-				add_input(m_mutated_inputs[id]);
-			}
-			break;
+		case Mode::Normal: {
+			// Skip the merge if this thread has recently seen this path.
+			// Slots start as 0, which is the path of empty coverage.
+			uint64_t path = cov.fingerprint();
+			uint64_t& seen = m_seen_paths[id][path & (SEEN_PATHS_SIZE - 1)];
+			if (seen == path)
+				return false;
+			seen = path;
+			return m_recorded_coverage.add(cov);
+		}
+		case Mode::CrashesMinimization:
 		case Mode::Unknown:
-			ASSERT(false, "mode not set");
+			ASSERT(false, "unexpected mode %d", m_mode);
 	}
+	return false;
+}
+
+void Corpus::add_new_input(int id, const string& input, const Coverage& cov,
+                           const InputReadInfo& read_info,
+                           const ExecInfo& exec_info)
+{
+	// Credit the input it was mutated from, and add it one generation deeper
+	size_t parent = m_mutated_inputs_indexes[id];
+	m_scheduler.coverage_found(parent);
+	add_input(input, read_info, exec_info, m_scheduler.depth(parent) + 1, cov);
 }
 
 void Corpus::handle_cov_corpus_minimization(int id, const Coverage& cov) {
@@ -298,162 +461,256 @@ void Corpus::handle_cov_corpus_minimization(int id, const Coverage& cov) {
 	if (cov == m_coverages[i]) {
 		const string& mutated_input = m_mutated_inputs[id];
 		while (m_lock_corpus.test_and_set());
-		if (mutated_input.size() < m_corpus[i].size()) {
-			m_corpus[i] = mutated_input;
+		const InputRef& input = m_corpus[i].data;
+		if (mutated_input.size() < input.size()) {
+			m_corpus.replace(i, { m_storage.store(mutated_input),
+			                      InputReadInfo::whole(mutated_input.size()) });
 			write_min_corpus_file(i);
 		}
 		m_lock_corpus.clear();
 	}
 }
 
+void Corpus::update_schedule() {
+	if (m_mode == Mode::Normal)
+		m_scheduler.update();
+}
+
+// Coverage checkpoint is an array of uint64_t: magic, number of entries of
+// the pack whose coverage is included, number of keys, and the keys
+static const uint64_t CHECKPOINT_MAGIC = 0x3130305450434b43; // "CKCPT001"
+
+void Corpus::checkpoint() {
+	if (m_mode != Mode::Normal)
+		return;
+
+	// Build the checkpoint in the writer thread, from the coverage of the
+	// entries appended to the pack so far. The recorded coverage can't be
+	// used, as it includes inputs whose append is still pending. Make sure
+	// those entries are on disk before writing a checkpoint that says so,
+	// and replace the previous checkpoint atomically.
+	string checkpoint_path = m_checkpoint_path;
+	m_writer->run([this, checkpoint_path]() {
+		vector<uint64_t> data = { CHECKPOINT_MAGIC, m_pack->size(), 0 };
+		m_pack_coverage.collect(data);
+		data[2] = data.size() - 3;
+		m_pack->sync();
+
+		string tmp_path = checkpoint_path + ".tmp";
+		::write_file(tmp_path, (const char*)data.data(),
+		             data.size()*sizeof(data[0]));
+		ERROR_ON(rename(tmp_path.c_str(), checkpoint_path.c_str()) == -1,
+		         "renaming %s", tmp_path.c_str());
+	});
+}
+
+size_t Corpus::read_checkpoint() {
+	// If there's no valid checkpoint, the coverage of every entry is merged
+	if (access(m_checkpoint_path.c_str(), F_OK) != 0)
+		return 0;
+	string data = read_file(m_checkpoint_path);
+	const uint64_t* p = (const uint64_t*)data.data();
+	size_t n = data.size() / sizeof(uint64_t);
+	if (n < 3 || p[0] != CHECKPOINT_MAGIC || p[2] != n - 3 ||
+	    p[1] > m_corpus.size())
+	{
+		cout << "Ignoring bad coverage checkpoint " << m_checkpoint_path << endl;
+		return 0;
+	}
+
+	m_pack_coverage.restore(p + 3, p[2]);
+	return p[1];
+}
+
 void Corpus::minimize() {
-#ifdef ENABLE_COVERAGE_BREAKPOINTS
 	ASSERT(m_mode == Mode::CorpusMinimization, "mode %d", m_mode);
 	ASSERT(m_coverages.size() == m_corpus.size(), "size mismatch: %lu vs %lu",
 	       m_coverages.size(), m_corpus.size());
-
-	// Calculate union of all coverages
-	SharedCoverage missing_coverage;
-	for (const Coverage& coverage : m_coverages) {
-		missing_coverage.add(coverage);
-	}
+	size_t n = m_corpus.size();
+	int nthreads = m_mutated_inputs.size();
+
+	// Get the keys covered by each input, and map them to dense indexes of
+	// the blocks or edges covered by the whole corpus
+	vector<vector<uint64_t>> keys(n);
+	parallel_for(nthreads, n, [&](size_t i) {
+		m_coverages[i].collect(keys[i]);
+	});
+	vector<uint64_t> all_keys;
+	for (const vector<uint64_t>& input_keys : keys)
+		all_keys.insert(all_keys.end(), input_keys.begin(), input_keys.end());
+	sort(all_keys.begin(), all_keys.end());
+	all_keys.erase(unique(all_keys.begin(), all_keys.end()), all_keys.end());
+	size_t n_blocks = all_keys.size();
+	parallel_for(nthreads, n, [&](size_t i) {
+		for (uint64_t& key : keys[i])
+			key = lower_bound(all_keys.begin(), all_keys.end(), key) -
+			      all_keys.begin();
+	});
 
 	// Afl-cmin algorithm
-	std::vector<std::string> new_corpus;
-	const size_t INVALID_INDEX = numeric_limits<size_t>::max();
-	while (missing_coverage.count() > 0) {
-		// 1. Find next basic block not yet in the temporary working set
-		size_t missing = *missing_coverage.begin();
-
-		// 2. Locate the winning corpus entry for this basic block, which is
-		//    the smallest that covers it
-		size_t i_winning = INVALID_INDEX;
-		for (size_t i = 0; i < m_coverages.size(); i++) {
-			if (!m_coverages[i].contains(missing))
-				continue;
-			bool is_better = m_corpus[i].size() < m_corpus[i_winning].size();
-			if (is_better || i_winning == INVALID_INDEX)
-				i_winning = i;
+	// 1. Locate the winning corpus entry for each block, which is the
+	//    smallest that covers it. Winners are packed as size << 32 | index,
+	//    so the winner is the minimum.
+	vector<atomic<uint64_t>> winners(n_blocks);
+	for (atomic<uint64_t>& winner : winners)
+		winner = numeric_limits<uint64_t>::max();
+	parallel_for(nthreads, n, [&](size_t i) {
+		uint64_t size = min(m_corpus[i].data.size(), (size_t)0xFFFFFFFF);
+		uint64_t candidate = (size << 32) | i;
+		for (uint64_t block : keys[i]) {
+			uint64_t winner = winners[block].load(memory_order_relaxed);
+			while (candidate < winner &&
+			       !winners[block].compare_exchange_weak(winner, candidate,
+			                                             memory_order_relaxed));
 		}
-		ASSERT(i_winning != INVALID_INDEX, "there's no input that covers bb?");
+	});
+
+	// 2. Go through the blocks. For each one not yet in the temporary working
+	//    set, take its winning entry and register every block it reaches
+	vector<bool> covered(n_blocks);
+	vector<Entry> new_corpus;
+	vector<Coverage> new_coverages;
+	vector<string> new_seeds_filenames;
+	for (size_t block = 0; block < n_blocks; block++) {
+		if (covered[block])
+			continue;
+		size_t i_winning = winners[block] & 0xFFFFFFFF;
 		new_corpus.push_back(m_corpus[i_winning]);
-
-		// 3. Register all basic blocks reached by the winning entry
-		for (vaddr_t bb_reached : m_coverages[i_winning]) {
-			missing_coverage.remove(bb_reached);
-		}
+		new_coverages.push_back(m_coverages[i_winning]);
+		new_seeds_filenames.push_back(m_seeds_filenames[i_winning]);
+		for (uint64_t block_reached : keys[i_winning])
+			covered[block_reached] = true;
 	}
 
-	m_corpus = new_corpus;
-#else
-	// TODO maybe
-#endif
+	// Keep coverages and filenames in the same order as the corpus
+	set_corpus(new_corpus);
+	m_coverages = move(new_coverages);
+	m_seeds_filenames = move(new_seeds_filenames);
 }
 
 
-void Corpus::add_input(const string& new_input){
+void Corpus::set_corpus(const vector<Entry>& entries) {
+	// Entries' inputs are already in our storage
+	m_corpus.clear();
+	for (const Entry& entry : entries)
+		m_corpus.push_back(entry);
+}
+
+void Corpus::add_input(const string& new_input,
+                       const InputReadInfo& read_info,
+                       const ExecInfo& exec_info, size_t depth,
+                       const Coverage& cov)
+{
 	ASSERT(m_mode == Mode::Normal, "adding input to corpus in mode %d", m_mode);
+	size_t size = new_input.size();
+	if (!read_info.size_observed)
+		size = min(size, read_info.max_offset);
+	vector<uint64_t> keys;
+	cov.collect(keys);
 	while (m_lock_corpus.test_and_set());
-	size_t i = m_corpus.size();
-	m_corpus.push_back(new_input);
+	if (!m_corpus_paths.insert(cov.fingerprint()).second) {
+		// There's already an input in the corpus with the same path
+		m_lock_corpus.clear();
+		return;
+	}
+	InputRef input = m_storage.store(new_input.data(), size);
+	size_t i = m_corpus.push_back({ input, read_info });
+	m_scheduler.add_entry(i, size, exec_info, depth, keys);
+
+	// Append to the pack in the writer thread. Pushing it while holding the
+	// lock keeps the order of the pack the same as the corpus
+	uint64_t path = cov.fingerprint();
+	m_writer->run([this, input, keys, path, depth, exec_info, read_info]() {
+		m_pack->append(input.data(), input.size(), keys, path, depth,
+		               exec_info, read_info);
+		m_pack_coverage.restore(keys.data(), keys.size());
+	});
 	m_lock_corpus.clear();
 	write_corpus_file(i);
 }
 
 // MUTATION STUFF
-// I don't remember a shit about this code and I'm not gonna bother reading it
-const vector<Corpus::mutation_strat_t> Corpus::mut_strats = {
-	&Corpus::mut_shrink,
-	&Corpus::mut_expand,
-	&Corpus::mut_bit,
-	&Corpus::mut_dec_byte,
-	&Corpus::mut_inc_byte,
-	&Corpus::mut_neg_byte,
-	&Corpus::mut_add_sub,
-	&Corpus::mut_set,
-	&Corpus::mut_swap,
-	&Corpus::mut_copy,
-	&Corpus::mut_inter_splice,
-	&Corpus::mut_insert_rand,
-	&Corpus::mut_overwrite_rand,
-	&Corpus::mut_byte_repeat_overwrite,
-	&Corpus::mut_byte_repeat_insert,
-	&Corpus::mut_magic_overwrite,
-	&Corpus::mut_magic_insert,
-	&Corpus::mut_random_overwrite,
-	&Corpus::mut_random_insert,
-	&Corpus::mut_splice_overwrite,
-	&Corpus::mut_splice_insert,
-};
-
-const vector<Corpus::mutation_strat_t> Corpus::mut_strats_reduce = {
-	&Corpus::mut_shrink,
-	&Corpus::mut_bit,
-	&Corpus::mut_dec_byte,
-	&Corpus::mut_inc_byte,
-	&Corpus::mut_neg_byte,
-	&Corpus::mut_add_sub,
-	&Corpus::mut_set,
-	&Corpus::mut_swap,
-	&Corpus::mut_copy,
+// Mutations work in place on the input, which is a per-thread string whose
+// capacity is at least the max input size. Bytes are moved with memmove and
+// resizing never exceeds that capacity, so they never allocate memory.
+struct Mutation {
+	std::string& input;
+	const InputReadInfo& read_info;
+	size_t max_input_size;
+	const Corpus& corpus;
+	Rng& rng;
 };
 
-void Corpus::mutate_input(int id, Rng& rng){
-	static_assert(MIN_MUTATIONS <= MAX_MUTATIONS);
-	static_assert(MAX_MUTATIONS != 0, "MAX_MUTATIONS must be positive. To "
-	              "disable mutations undef ENABLE_MUTATIONS instead.");
-#ifndef ENABLE_MUTATIONS
-	return;
-#endif
+typedef void (*mutation_strat_t)(Mutation& mut);
 
-	string& input = m_mutated_inputs[id];
-	size_t n_muts = rng.rnd(MIN_MUTATIONS, MAX_MUTATIONS);
-	mutation_strat_t mut_strat;
-	if (m_mode == Mode::Normal) {
-		for (size_t i = 0; i < n_muts; i++){
-			mut_strat = mut_strats[rng.rnd(0, mut_strats.size()-1)];
-			(this->*mut_strat)(input, rng);
-		}
-		ASSERT(input.size() <= m_max_input_size, "mutation too large: %ld/%ld",
-		       input.size(), m_max_input_size);
-	} else {
-		// We're in a minimization mode. Get mutation strategies from
-		// mut_strats_reduce instead, and make sure we apply shrink at
-		// least once
-		size_t j, i_mut_shrink = rng.rnd(0, n_muts - 1);
-		for (size_t i = 0; i < n_muts; i++) {
-			if (i == i_mut_shrink) {
-				mut_shrink(input, rng);
-			} else {
-				j = rng.rnd(0, mut_strats_reduce.size()-1);
-				mut_strat = mut_strats_reduce[j];
-				(this->*mut_strat)(input, rng);
-			}
-		}
-	}
-}
-
-/* POR QUÉ AL INSERTAR COGE EL TAMAÑO COMO SI FUERA A OVERWRITEAR?
-   ESO HACE QUE EL TAMAÑO DE LO QUE INSERTAS SEA MÁS PEQUEÑO CONFORME MÁS
-   CERCA DEL FINAL LO INSERTES */
-
-size_t rand_offset(const string& input, Rng& rng, bool plus_one=false){
+// Get a random offset of an input of given size. The offset is biased
+// toward the parts of the input that were read by the target.
+static size_t rand_offset(size_t size, const InputReadInfo& read_info,
+                          Rng& rng, bool plus_one=false)
+{
 	// Special case when input is empty. Some mutations may want to insert at
 	// index 0. In that case, `plus_one` must be true
-	if (input.empty()){
+	if (size == 0){
 		assert(plus_one);
 		return 0;
 	}
-	return rng.rnd_exp(0, input.size() - (!plus_one));
+	size_t max_offset = size - (!plus_one);
+
+	// Most of the time, choose an offset inside a part of the input that was
+	// read by the target, as mutating the rest is pointless. Previous
+	// mutations may have moved bytes around, so this is just a hint.
+	if (read_info.num_ranges && rng.rnd(0, 7)) {
+		size_t i = rng.rnd(0, read_info.num_ranges - 1);
+		const InputReadInfo::Range& range = read_info.ranges[i];
+		size_t range_end = min(range.end - (!plus_one), max_offset);
+		if (range.start <= range_end)
+			return range.start + rng.rnd_exp(0, range_end - range.start);
+	}
+	return rng.rnd_exp(0, max_offset);
 }
 
-void Corpus::mut_shrink(string& input, Rng& rng){
+static size_t rand_offset(Mutation& mut, bool plus_one=false) {
+	return rand_offset(mut.input.size(), mut.read_info, mut.rng, plus_one);
+}
+
+// Make room for `len` bytes at `offset`, and return a pointer to them
+static char* insert_gap(string& input, size_t offset, size_t len) {
+	size_t size = input.size();
+	input.resize(size + len);
+	char* p = &input[0];
+	memmove(p + offset + len, p + offset, size - offset);
+	return p + offset;
+}
+
+// Remove `len` bytes at `offset`
+static void erase(string& input, size_t offset, size_t len) {
+	char* p = &input[0];
+	memmove(p + offset, p + offset + len, input.size() - offset - len);
+	input.resize(input.size() - len);
+}
+
+// Replace `dst_len` bytes at `offset` with `src_len` bytes from `src`, which
+// must not point into `input`
+static void replace(string& input, size_t offset, size_t dst_len,
+                    const char* src, size_t src_len)
+{
+	if (src_len > dst_len)
+		insert_gap(input, offset + dst_len, src_len - dst_len);
+	else if (src_len < dst_len)
+		erase(input, offset + src_len, dst_len - src_len);
+	memcpy(&input[offset], src, src_len);
+}
+
+static void mut_shrink(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Offset to remove data at
-	size_t offset = rand_offset(input, rng);
+	size_t offset = rand_offset(mut);
 
 	// Maximum number of bytes we'll remove.
 	// 15/16 chance of removing at most 16 bytes
@@ -466,19 +723,22 @@ void Corpus::mut_shrink(string& input, Rng& rng){
 	size_t to_remove = rng.rnd_exp(1, max_remove);
 
 	// Remove bytes
-	input.erase(offset, to_remove);
+	erase(input, offset, to_remove);
 }
 
-void Corpus::mut_expand(string& input, Rng& rng){
+static void mut_expand(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check size
-	if (input.size() >= m_max_input_size)
+	if (input.size() >= mut.max_input_size)
 		return;
 
 	// Offset to insert data at
-	size_t offset = rand_offset(input, rng, true);
+	size_t offset = rand_offset(mut, true);
 
 	// Maximum number of bytes we'll insert. Same as in `shrink`
-	size_t max_expand = m_max_input_size - input.size();
+	size_t max_expand = mut.max_input_size - input.size();
 	size_t rnd = rng.rnd(1, 16);
 	max_expand = (rnd == 1 ? max_expand : min((size_t)16, max_expand));
 
@@ -486,57 +746,68 @@ void Corpus::mut_expand(string& input, Rng& rng){
 	size_t to_expand = rng.rnd_exp(1, max_expand);
 
 	// Insert bytes
-	input.insert(offset, to_expand, '\x00');
+	memset(insert_gap(input, offset, to_expand), 0, to_expand);
 }
 
-void Corpus::mut_bit(string& input, Rng& rng){
+static void mut_bit(Mutation& mut){
+	string& input = mut.input;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Flip random bit at random offset
-	size_t offset  = rand_offset(input, rng);
-	uint8_t bit    = rng.rnd(0, 7);
+	size_t offset  = rand_offset(mut);
+	uint8_t bit    = mut.rng.rnd(0, 7);
 	input[offset] ^= (1 << bit);
 }
 
-void Corpus::mut_inc_byte(string& input, Rng& rng){
+static void mut_inc_byte(Mutation& mut){
+	string& input = mut.input;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Increment byte at random offset
-	size_t offset = rand_offset(input, rng);
+	size_t offset = rand_offset(mut);
 	input[offset]++;
 }
 
-void Corpus::mut_dec_byte(string& input, Rng& rng){
+static void mut_dec_byte(Mutation& mut){
+	string& input = mut.input;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Decrement byte at random offset
-	size_t offset = rand_offset(input, rng);
+	size_t offset = rand_offset(mut);
 	input[offset]--;
 }
 
-void Corpus::mut_neg_byte(string& input, Rng& rng){
+static void mut_neg_byte(Mutation& mut){
+	string& input = mut.input;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Negate byte at random offset
-	size_t offset = rand_offset(input, rng);
+	size_t offset = rand_offset(mut);
 	input[offset] = ~input[offset];
 }
 
-void Corpus::mut_add_sub(string& input, Rng& rng){
+static void mut_add_sub(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Offset of the integer we'll modify
-	size_t offset = rand_offset(input, rng);
+	size_t offset = rand_offset(mut);
 
 	// Remaining bytes
 	size_t remain = input.size() - offset;
@@ -590,52 +861,58 @@ void Corpus::mut_add_sub(string& input, Rng& rng){
 	#undef mut
 }
 
-void Corpus::mut_set(string& input, Rng& rng){
+static void mut_set(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Get offset, len and value to memset
-	size_t  offset = rand_offset(input, rng);
+	size_t  offset = rand_offset(mut);
 	size_t  len    = rng.rnd_exp(1, input.size() - offset);
 	uint8_t c      = rng.rnd(0, 255);
 
 	// Replace
-	input.replace(offset, len, len, c);
+	memset(&input[offset], c, len);
 }
 
-void Corpus::mut_swap(string& input, Rng& rng){
+static void mut_swap(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Get random offsets and their remaining bytes
-	size_t offset1 = rand_offset(input, rng);
-	size_t offset2 = rand_offset(input, rng);
+	size_t offset1 = rand_offset(mut);
+	size_t offset2 = rand_offset(mut);
 	size_t offset1_remaining = input.size() - offset1;
 	size_t offset2_remaining = input.size() - offset2;
 
 	// Get random length
 	size_t len = rng.rnd_exp(1, min(offset1_remaining, offset2_remaining));
 
-	// Save input[offset1 : offset1+len] into tmp
-	string tmp = input.substr(offset1, len);
-
-	// Set input[offset1 : offset1+len] = input[offset2 : offset2+len]
-	input.replace(offset1, len, input, offset2, len);
-
-	// Set input[offset2 : offset2+len] = tmp
-	input.replace(offset2, len, tmp);
+	// Swap input[offset1 : offset1+len] and input[offset2 : offset2+len]
+	// byte by byte, so we don't need a temporary buffer. Ranges may overlap.
+	char* p = &input[0];
+	for (size_t i = 0; i < len; i++)
+		swap(p[offset1 + i], p[offset2 + i]);
 }
 
-void Corpus::mut_copy(string& input, Rng& rng){
+static void mut_copy(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Get random offsets and their remaining bytes
-	size_t src = rand_offset(input, rng);
-	size_t dst = rand_offset(input, rng);
+	size_t src = rand_offset(mut);
+	size_t dst = rand_offset(mut);
 	size_t src_remaining = input.size() - src;
 	size_t dst_remaining = input.size() - dst;
 
@@ -643,206 +920,302 @@ void Corpus::mut_copy(string& input, Rng& rng){
 	size_t len = rng.rnd_exp(1, min(src_remaining, dst_remaining));
 
 	// Replace
-	input.replace(dst, len, input, src, len);
+	memmove(&input[dst], &input[src], len);
 }
 
-void Corpus::mut_inter_splice(string& input, Rng& rng){
+static void mut_inter_splice(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Check size
-	if (input.size() >= m_max_input_size)
+	if (input.size() >= mut.max_input_size)
 		return;
 
 	// Get random offsets and a random length
-	size_t src = rand_offset(input, rng);
-	size_t dst = rand_offset(input, rng, true);
+	size_t src = rand_offset(mut);
+	size_t dst = rand_offset(mut, true);
 	size_t src_remaining = input.size() - src;
-	size_t max_insert    = m_max_input_size - input.size();
+	size_t max_insert    = mut.max_input_size - input.size();
 	size_t len = rng.rnd_exp(1, min(src_remaining, max_insert));
 
-	// Insert
-	input.insert(dst, input, src, len);
+	// Insert. Bytes of the source that were after `dst` have been moved
+	// `len` bytes forward by the gap.
+	char* p = insert_gap(input, dst, len) - dst;
+	size_t len1 = (src < dst ? min(len, dst - src) : 0);
+	memcpy(p + dst, p + src, len1);
+	memcpy(p + dst + len1, p + src + len1 + len, len - len1);
 }
 
-inline void fill_rand_bytes(string& s, Rng& rng){
-	size_t len = s.size();
-	for (size_t i = 0; i < len; i++)
-		s[i] = rng.rnd(0x00, 0xFF);
-}
+static void mut_insert_rand(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
 
-void Corpus::mut_insert_rand(string& input, Rng& rng){
 	// Check size
-	if (input.size() >= m_max_input_size)
+	if (input.size() >= mut.max_input_size)
 		return;
 
 	// Get one or two random bytes and insert them at a random offset
-	size_t max_insert = m_max_input_size - input.size();
-	size_t offset = rand_offset(input, rng, true);
-	string bytes(min(rng.rnd(1,2), max_insert), '\x00');
-	fill_rand_bytes(bytes, rng);
-	input.insert(offset, bytes);
+	size_t max_insert = mut.max_input_size - input.size();
+	size_t offset = rand_offset(mut, true);
+	size_t len = min(rng.rnd(1,2), max_insert);
+	rng.fill(insert_gap(input, offset, len), len);
 }
 
-void Corpus::mut_overwrite_rand(string& input, Rng& rng){
+static void mut_overwrite_rand(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Overwrite one or two input bytes with random bytes
-	size_t offset = rand_offset(input, rng);
+	size_t offset = rand_offset(mut);
 	size_t len    = (input.size()-offset > 1 ? rng.rnd(1, 2) : 1);
-	string bytes(len, '\x00');
-	fill_rand_bytes(bytes, rng);
-	input.replace(offset, len, bytes);
+	rng.fill(&input[offset], len);
 }
 
-void Corpus::mut_byte_repeat_overwrite(string& input, Rng& rng){
-	// Check empty input
-	if (input.empty())
+static void mut_byte_repeat_overwrite(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
+	// Check there's at least one byte after the one we'll repeat
+	if (input.size() < 2)
 		return;
 
 	// Get random offset and amount
-	size_t offset = rand_offset(input, rng);
-	size_t amount = rng.rnd_exp(1, input.size() - offset);
+	size_t offset = rand_offset(mut);
+	if (offset == input.size() - 1)
+		return;
+	size_t amount = rng.rnd_exp(1, input.size() - offset - 1);
 
-	// Get byte to repeat and overwrite `amount` bytes with it
-	char val = input[offset];
-	for (size_t i = 0; i < amount; i++)
-		input[offset + i + 1] = val;
+	// Get byte to repeat and overwrite `amount` bytes after it with it
+	memset(&input[offset + 1], input[offset], amount);
 }
 
-void Corpus::mut_byte_repeat_insert(string& input, Rng& rng){
+static void mut_byte_repeat_insert(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Check size
-	if (input.size() >= m_max_input_size)
+	if (input.size() >= mut.max_input_size)
 		return;
 
 	// Get random offset and amount
-	size_t offset = rand_offset(input, rng);
-	size_t max_amount = m_max_input_size - input.size();
+	size_t offset = rand_offset(mut);
+	size_t max_amount = mut.max_input_size - input.size();
 	size_t amount = rng.rnd_exp(1, min(input.size() - offset, max_amount));
 
 	// Get byte to repeat and insert it `amount` times
 	char val = input[offset];
-	string bytes(amount, val);
-	input.insert(offset, bytes);
+	memset(insert_gap(input, offset, amount), val, amount);
 }
 
-void Corpus::mut_magic_overwrite(string& input, Rng& rng){
+static void mut_magic_overwrite(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Get random offset and magic value
-	size_t offset = rand_offset(input, rng);
-	string magic_value = MAGIC_VALUES[rng.rnd(0, MAGIC_VALUES.size()-1)];
+	size_t offset = rand_offset(mut);
+	const string& magic_value = MAGIC_VALUES[rng.rnd(0, MAGIC_VALUES.size()-1)];
 
 	// Truncate magic value if needed
 	size_t remain = input.size() - offset;
 	size_t len    = min(magic_value.size(), remain);
 
 	// Replace bytes with magic value
-	input.replace(offset, len, magic_value, 0, len);
+	memcpy(&input[offset], magic_value.c_str(), len);
 }
 
-void Corpus::mut_magic_insert(string& input, Rng& rng){
+static void mut_magic_insert(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check size
-	if (input.size() >= m_max_input_size)
+	if (input.size() >= mut.max_input_size)
 		return;
 
 	// Get random offset and magic value
-	size_t offset = rand_offset(input, rng, true);
-	string magic_value = MAGIC_VALUES[rng.rnd(0, MAGIC_VALUES.size()-1)];
+	size_t offset = rand_offset(mut, true);
+	const string& magic_value = MAGIC_VALUES[rng.rnd(0, MAGIC_VALUES.size()-1)];
 
 	// Truncate magic value if needed
-	size_t max_len = m_max_input_size - input.size();
+	size_t max_len = mut.max_input_size - input.size();
 	size_t len     = min(magic_value.size(), max_len);
 
 	// Insert magic value
-	input.insert(offset, magic_value, 0, len);
+	memcpy(insert_gap(input, offset, len), magic_value.c_str(), len);
 }
 
-void Corpus::mut_random_overwrite(string& input, Rng& rng){
+static void mut_random_overwrite(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Get random offset and amount to overwrite
-	size_t offset = rand_offset(input, rng);
+	size_t offset = rand_offset(mut);
 	size_t amount = rng.rnd_exp(1, input.size() - offset);
 
-	// Get random bytes
-	string bytes(amount, '\x00');
-	fill_rand_bytes(bytes, rng);
-
 	// Replace with random bytes
-	input.replace(offset, amount, bytes);
+	rng.fill(&input[offset], amount);
 }
 
-void Corpus::mut_random_insert(string& input, Rng& rng){
+static void mut_random_insert(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check size
-	if (input.size() >= m_max_input_size)
+	if (input.size() >= mut.max_input_size)
 		return;
 
 	// Get random offset and amount to insert
-	size_t offset = rand_offset(input, rng, true);
-	size_t max_amount = m_max_input_size - input.size();
+	size_t offset = rand_offset(mut, true);
+	size_t max_amount = mut.max_input_size - input.size();
 	size_t amount = rng.rnd_exp(0, min(input.size() - offset, max_amount));
 
-	// Get random bytes
-	string bytes(amount, '\x00');
-	fill_rand_bytes(bytes, rng);
-
 	// Insert random bytes
-	input.insert(offset, bytes);
+	rng.fill(insert_gap(input, offset, amount), amount);
 }
 
-void Corpus::mut_splice_overwrite(string& input, Rng& rng){
+static void mut_splice_overwrite(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check empty input
 	if (input.empty())
 		return;
 
 	// Get the random input we'll copy from and check it is not empty
-	// TODO: need lock here?
-	const string& inp = m_corpus[rng.rnd(0, m_corpus.size()-1)];
+	const Corpus::Entry& entry = mut.corpus.entry(rng.rnd(0, mut.corpus.size()-1));
+	const InputRef& inp = entry.data;
 	if (inp.empty())
 		return;
 
 	// Get dst and src offsets and lengths, making sure we don't exceed
 	// max_input_size when replacing
-	size_t dst_off = rand_offset(input, rng);
+	size_t dst_off = rand_offset(mut);
 	size_t dst_len = rng.rnd_exp(1, input.size() - dst_off);
-	size_t src_off = rand_offset(inp, rng);
-	size_t max_src_len = m_max_input_size - input.size() + dst_len;
+	size_t src_off = rand_offset(inp.size(), entry.read_info, rng);
+	size_t max_src_len = mut.max_input_size - input.size() + dst_len;
 	size_t src_len = rng.rnd_exp(1, min(inp.size() - src_off, max_src_len));
 
 	// Replace
-	input.replace(dst_off, dst_len, inp, src_off, src_len);
+	replace(input, dst_off, dst_len, inp.data() + src_off, src_len);
 }
 
-void Corpus::mut_splice_insert(string& input, Rng& rng){
+static void mut_splice_insert(Mutation& mut){
+	string& input = mut.input;
+	Rng& rng = mut.rng;
+
 	// Check size
-	if (input.size() >= m_max_input_size)
+	if (input.size() >= mut.max_input_size)
 		return;
 
 	// Get the random input we'll copy from and check it is not empty
-	// TODO: need lock here?
-	const string& inp = m_corpus[rng.rnd(0, m_corpus.size()-1)];
+	const Corpus::Entry& entry = mut.corpus.entry(rng.rnd(0, mut.corpus.size()-1));
+	const InputRef& inp = entry.data;
 	if (inp.empty())
 		return;
 
 	// Get dst and src offsets and src length, making sure we don't exceed
 	// max_input_size when inserting
-	size_t dst_off = rand_offset(input, rng, true);
-	size_t src_off = rand_offset(inp, rng);
-	size_t max_src_len = m_max_input_size - input.size();
+	size_t dst_off = rand_offset(mut, true);
+	size_t src_off = rand_offset(inp.size(), entry.read_info, rng);
+	size_t max_src_len = mut.max_input_size - input.size();
 	size_t src_len = rng.rnd_exp(1, min(inp.size() - src_off, max_src_len));
 
 	// Insert
-	input.insert(dst_off, inp, src_off, src_len);
+	memcpy(insert_gap(input, dst_off, src_len), inp.data() + src_off, src_len);
+}
+
+static const mutation_strat_t mut_strats[] = {
+	mut_shrink,
+	mut_expand,
+	mut_bit,
+	mut_dec_byte,
+	mut_inc_byte,
+	mut_neg_byte,
+	mut_add_sub,
+	mut_set,
+	mut_swap,
+	mut_copy,
+	mut_inter_splice,
+	mut_insert_rand,
+	mut_overwrite_rand,
+	mut_byte_repeat_overwrite,
+	mut_byte_repeat_insert,
+	mut_magic_overwrite,
+	mut_magic_insert,
+	mut_random_overwrite,
+	mut_random_insert,
+	mut_splice_overwrite,
+	mut_splice_insert,
+};
+
+static const mutation_strat_t mut_strats_reduce[] = {
+	mut_shrink,
+	mut_bit,
+	mut_dec_byte,
+	mut_inc_byte,
+	mut_neg_byte,
+	mut_add_sub,
+	mut_set,
+	mut_swap,
+	mut_copy,
+};
+
+static const size_t n_mut_strats = sizeof(mut_strats)/sizeof(mut_strats[0]);
+static const size_t n_mut_strats_reduce =
+	sizeof(mut_strats_reduce)/sizeof(mut_strats_reduce[0]);
+
+void Corpus::mutate_input(int id, Rng& rng){
+	static_assert(MIN_MUTATIONS <= MAX_MUTATIONS, "bad number of mutations");
+	static_assert(MAX_MUTATIONS != 0, "MAX_MUTATIONS must be positive. To "
+	              "disable mutations undef ENABLE_MUTATIONS instead.");
+#ifndef ENABLE_MUTATIONS
+	return;
+#endif
+
+	Mutation mut = {
+		.input          = m_mutated_inputs[id],
+		.read_info      = m_mutated_inputs_read_infos[id],
+		.max_input_size = m_max_input_size,
+		.corpus         = *this,
+		.rng            = rng,
+	};
+	size_t n_muts = rng.rnd(MIN_MUTATIONS, MAX_MUTATIONS);
+	if (m_mode == Mode::Normal) {
+		for (size_t i = 0; i < n_muts; i++){
+			mut_strats[rng.rnd(0, n_mut_strats-1)](mut);
+		}
+		ASSERT(mut.input.size() <= m_max_input_size, "mutation too large: "
+		       "%ld/%ld", mut.input.size(), m_max_input_size);
+	} else {
+		// We're in corpus minimization mode. Get mutation strategies from
+		// mut_strats_reduce instead, and make sure we apply shrink at
+		// least once
+		size_t i_mut_shrink = rng.rnd(0, n_muts - 1);
+		for (size_t i = 0; i < n_muts; i++) {
+			if (i == i_mut_shrink) {
+				mut_shrink(mut);
+			} else {
+				mut_strats_reduce[rng.rnd(0, n_mut_strats_reduce-1)](mut);
+			}
+		}
+	}
 }
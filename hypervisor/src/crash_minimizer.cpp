@@ -0,0 +1,165 @@
+#include <chrono>
+#include "crash_minimizer.h"
+
+using namespace std;
+
+CrashMinimizer::CrashMinimizer(const Vm& base, int nthreads)
+	: m_base(base)
+	, m_nthreads(nthreads)
+	, m_num_candidates(0)
+	, m_fault{}
+	, m_step(0)
+	, m_threads_done(0)
+	, m_stop(false)
+	, m_next(0)
+	, m_first(0)
+	, m_runs(0)
+{
+}
+
+void CrashMinimizer::work() {
+	Vm vm(m_base);
+	Stats stats;
+	size_t step = 0;
+	unique_lock<mutex> lock(m_mutex);
+	while (true) {
+		m_step_started.wait(lock, [&]() { return m_stop || m_step != step; });
+		if (m_stop)
+			break;
+		step = m_step;
+		lock.unlock();
+
+		// Candidates are taken in order, so once we get one after the first
+		// that keeps the fault, there's nothing left worth running
+		size_t i;
+		while ((i = m_next++) < m_num_candidates && i < m_first) {
+			vm.set_input(m_candidates[i]);
+			Vm::RunEndReason reason = vm.run(stats);
+			bool same_fault = (reason == Vm::RunEndReason::Crash &&
+			                   vm.fault() == m_fault);
+			vm.reset_coverage();
+			vm.reset(m_base, stats);
+			m_runs++;
+			if (same_fault) {
+				size_t first = m_first;
+				while (i < first && !m_first.compare_exchange_weak(first, i));
+			}
+		}
+
+		lock.lock();
+		if (++m_threads_done == m_nthreads)
+			m_step_done.notify_one();
+	}
+}
+
+void CrashMinimizer::stop() {
+	lock_guard<mutex> lock(m_mutex);
+	m_stop = true;
+	m_step_started.notify_all();
+}
+
+size_t CrashMinimizer::first_crashing(size_t n, const FaultInfo& fault) {
+	unique_lock<mutex> lock(m_mutex);
+	m_num_candidates = n;
+	m_fault = fault;
+	m_next = 0;
+	m_first = n;
+	m_threads_done = 0;
+	m_step++;
+	m_step_started.notify_all();
+	m_step_done.wait(lock, [&]() { return m_threads_done == m_nthreads; });
+	return m_first;
+}
+
+string& CrashMinimizer::candidate(size_t i) {
+	if (i >= m_candidates.size())
+		m_candidates.resize(i + 1);
+	return m_candidates[i];
+}
+
+void CrashMinimizer::remove_chunks(string& input, const FaultInfo& fault) {
+	// Split the input into `n` chunks. If keeping only one of them or removing
+	// one of them keeps the fault, take it and continue with less chunks.
+	// Otherwise, double the number of chunks until they are single bytes.
+	// Every candidate of a round is run at once: first the ones that keep one
+	// chunk, then the ones that remove one.
+	size_t n = 2;
+	while (input.size() >= 2) {
+		size_t chunk_size = (input.size() + n - 1) / n;
+		size_t num_candidates = 0;
+
+		// With two chunks, keeping one is the same as removing the other
+		if (n > 2) {
+			for (size_t offset = 0; offset < input.size(); offset += chunk_size)
+				candidate(num_candidates++).assign(input, offset, chunk_size);
+		}
+		size_t num_keep = num_candidates;
+		for (size_t offset = 0; offset < input.size(); offset += chunk_size) {
+			size_t len = min(chunk_size, input.size() - offset);
+			string& removed = candidate(num_candidates++);
+			removed.assign(input, 0, offset);
+			removed.append(input, offset + len, string::npos);
+		}
+
+		size_t i = first_crashing(num_candidates, fault);
+		if (i < num_candidates) {
+			input.swap(m_candidates[i]);
+			n = (i < num_keep ? 2 : max(n - 1, (size_t)2));
+		} else {
+			if (n >= input.size())
+				break;
+			n = min(n*2, input.size());
+		}
+	}
+}
+
+void CrashMinimizer::canonicalize(string& input, const FaultInfo& fault) {
+	// Replace the next bytes that aren't canonical, one in each candidate.
+	// If one keeps the fault, take it and continue after that byte, as the
+	// bytes after it must be tried again with the new input.
+	size_t pos = 0, max_candidates = m_nthreads;
+	vector<size_t> positions;
+	while (pos < input.size()) {
+		positions.clear();
+		for (; pos < input.size() && positions.size() < max_candidates; pos++) {
+			if (input[pos] == CANONICAL_BYTE)
+				continue;
+			string& replaced = candidate(positions.size());
+			replaced.assign(input);
+			replaced[pos] = CANONICAL_BYTE;
+			positions.push_back(pos);
+		}
+		if (positions.empty())
+			break;
+
+		size_t i = first_crashing(positions.size(), fault);
+		if (i < positions.size()) {
+			input.swap(m_candidates[i]);
+			pos = positions[i] + 1;
+		}
+	}
+}
+
+CrashMinimizer::Profile CrashMinimizer::minimize(string& input,
+                                                 const FaultInfo& fault)
+{
+	Profile profile;
+	profile.initial_size = input.size();
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	size_t runs = m_runs;
+	remove_chunks(input, fault);
+	profile.removal_runs = m_runs - runs;
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	profile.removal_time = chrono::duration<double>(end - start).count();
+
+	start = end;
+	runs = m_runs;
+	canonicalize(input, fault);
+	profile.canonicalization_runs = m_runs - runs;
+	end = chrono::steady_clock::now();
+	profile.canonicalization_time = chrono::duration<double>(end - start).count();
+
+	profile.final_size = input.size();
+	return profile;
+}
@@ -190,6 +190,10 @@ string ElfParser::path() const {
 	return m_path;
 }
 
+string ElfParser::name() const {
+	return m_path.substr(m_path.find_last_of('/') + 1);
+}
+
 string ElfParser::interpreter() const {
 	return m_interpreter;
 }
@@ -206,6 +210,16 @@ vector<symbol_t> ElfParser::symbols() const {
 	return m_symbols;
 }
 
+vector<symbol_t> ElfParser::function_symbols() const {
+	vector<symbol_t> result;
+	for (const symbol_t& symbol : m_symbols) {
+		if (symbol.type == STT_FUNC && symbol.shndx != SHN_UNDEF &&
+		    symbol.size != 0)
+			result.push_back(symbol);
+	}
+	return result;
+}
+
 pair<vaddr_t, vaddr_t> ElfParser::section_limits(const string& name) const {
 	for (const section_t& section : sections())
 		if (section.name == name)
@@ -0,0 +1,44 @@
+#include <algorithm>
+#include "exit_profile.h"
+#include "kvm_aux.h"
+
+using namespace std;
+
+vector<pair<uint64_t, uint64_t>> ExitProfile::top_debug_rips(size_t n) const {
+	vector<pair<uint64_t, uint64_t>> rips;
+	for (size_t i = 0; i < RIP_SLOTS; i++)
+		if (m_rips[i].rip && m_rips[i].count)
+			rips.push_back({m_rips[i].rip, m_rips[i].count});
+	n = min(n, rips.size());
+	partial_sort(rips.begin(), rips.begin() + n, rips.end(),
+		[](const pair<uint64_t, uint64_t>& a, const pair<uint64_t, uint64_t>& b) {
+			return a.second > b.second;
+		}
+	);
+	rips.resize(n);
+	return rips;
+}
+
+const char* ExitProfile::exit_reason_str(size_t reason) {
+#define CASE(name) case KVM_EXIT_##name: return #name;
+	switch (reason) {
+		CASE(UNKNOWN)
+		CASE(EXCEPTION)
+		CASE(IO)
+		CASE(HYPERCALL)
+		CASE(DEBUG)
+		CASE(HLT)
+		CASE(MMIO)
+		CASE(IRQ_WINDOW_OPEN)
+		CASE(SHUTDOWN)
+		CASE(FAIL_ENTRY)
+		CASE(INTR)
+		CASE(NMI)
+		CASE(INTERNAL_ERROR)
+		CASE(SYSTEM_EVENT)
+		CASE(VMX_PT_TOPA_MAIN_FULL)
+		default:
+			return "OTHER";
+	}
+#undef CASE
+}
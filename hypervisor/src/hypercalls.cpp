@@ -19,8 +19,21 @@ enum Hypercall : size_t {
 	SubmitTimeoutPointers,
 	PrintStacktrace,
 	EndRun,
+	SubmitSnapshotPointer,
+	SnapshotPoint,
 };
 
+const char* Vm::hypercall_str(size_t n) {
+	static const char* names[] = {
+		"Test", "Print", "GetMemInfo", "GetKernelBrk", "GetInfo", "GetFileLen",
+		"GetFileName", "SubmitFilePointers", "SubmitTimeoutPointers",
+		"PrintStacktrace", "EndRun", "SubmitSnapshotPointer", "SnapshotPoint",
+	};
+	if (n < sizeof(names)/sizeof(*names))
+		return names[n];
+	return "Unknown";
+}
+
 void Vm::do_hc_print(vaddr_t msg_addr) {
 	string msg = m_mmu.read_string(msg_addr);
 	cout << "[KERNEL] " << msg;
@@ -50,6 +63,19 @@ vaddr_t Vm::do_hc_get_kernel_brk() {
 	return m_kernel.initial_brk();
 }
 
+// Same as struct termios2 used by the kernel. The struct termios of glibc has
+// a bigger c_cc, so it can't be sent as it is.
+struct termios2_t {
+	tcflag_t c_iflag;
+	tcflag_t c_oflag;
+	tcflag_t c_cflag;
+	tcflag_t c_lflag;
+	cc_t c_line;
+	cc_t c_cc[19];
+	speed_t c_ispeed;
+	speed_t c_ospeed;
+};
+
 // Keep this the same as in the kernel
 struct VmInfo {
 	char elf_path[PATH_MAX];
@@ -62,8 +88,14 @@ struct VmInfo {
 	vaddr_t elf_load_addr;
 	vaddr_t interp_base;
 	phinfo_t phinfo;
-	struct termios term;
+	vaddr_t shared_mem;
+	uint64_t sample_interval;
+	termios2_t term;
 };
+static_assert(sizeof(VmInfo) == 4240, "VmInfo size changed");
+static_assert(offsetof(VmInfo, shared_mem) == 4176, "VmInfo layout changed");
+static_assert(offsetof(VmInfo, sample_interval) == 4184,
+              "VmInfo layout changed");
 
 void Vm::do_hc_get_info(vaddr_t info_addr) {
 	// Get absolute elf path, brk and other stuff
@@ -88,13 +120,26 @@ void Vm::do_hc_get_info(vaddr_t info_addr) {
 	info.interp_base   = (m_interpreter ? m_interpreter->base() : 0);
 	info.phinfo        = m_elf.phinfo();
 
-	// Make sure our struct termios corresponds to the struct termios2
+	info.shared_mem = m_mmu.shared_mem_vaddr();
+	info.sample_interval = m_sample_interval;
+
+	// Make sure our struct termios has the fields of the struct termios2
 	// that is used by the kernel
 	#if !defined(_HAVE_STRUCT_TERMIOS_C_ISPEED) ||   \
 	    !defined(_HAVE_STRUCT_TERMIOS_C_OSPEED)
 	#error struct termios in hypervisor is not struct termios2 in the kernel?
 	#endif
-	tcgetattr(STDOUT_FILENO, &info.term);
+	struct termios term;
+	memset(&term, 0, sizeof(term));
+	tcgetattr(STDOUT_FILENO, &term);
+	info.term.c_iflag  = term.c_iflag;
+	info.term.c_oflag  = term.c_oflag;
+	info.term.c_cflag  = term.c_cflag;
+	info.term.c_lflag  = term.c_lflag;
+	info.term.c_line   = term.c_line;
+	memcpy(info.term.c_cc, term.c_cc, sizeof(info.term.c_cc));
+	info.term.c_ispeed = term.c_ispeed;
+	info.term.c_ospeed = term.c_ospeed;
 
 	m_mmu.write(info_addr, info);
 }
@@ -149,12 +194,78 @@ void Vm::do_hc_print_stacktrace(vaddr_t rsp, vaddr_t rip, vaddr_t rbp) {
 	print_stacktrace(regs);
 }
 
+// Keep this the same as in the kernel
+struct EndRunInfo {
+	InputReadInfo input_read;
+	PerfCounters perf;
+};
+
 void Vm::do_hc_end_run(RunEndReason reason, vaddr_t info_addr,
-                       uint64_t instr_executed)
+                       uint64_t instr_executed, vaddr_t end_run_info_addr)
 {
-	set_instructions_executed(instr_executed);
 	if (reason == RunEndReason::Crash)
 		m_fault = m_mmu.read<FaultInfo>(info_addr);
+
+	// Kernels that don't provide an EndRunInfo pass a null pointer
+	if (end_run_info_addr) {
+		EndRunInfo info = m_mmu.read<EndRunInfo>(end_run_info_addr);
+		m_input_read_info = info.input_read;
+		ASSERT(m_input_read_info.num_ranges <= InputReadInfo::MAX_RANGES,
+		       "bad input read ranges: %lu", m_input_read_info.num_ranges);
+		set_perf_counters(info.perf);
+	} else {
+		PerfCounters counters = {};
+		counters.user_instructions = instr_executed;
+		set_perf_counters(counters);
+		auto it = m_file_contents.find("input");
+		size_t size = (it != m_file_contents.end() ? it->second.length : 0);
+		m_input_read_info = InputReadInfo::whole(size);
+	}
+}
+
+void Vm::do_hc_submit_snapshot_pointer(vaddr_t snapshot_offset_addr) {
+	m_snapshot_offset_addr = snapshot_offset_addr;
+}
+
+void Vm::do_hc_snapshot_point(size_t input_consumed) {
+	// Save registers as they will be when the hypercall returns. Every
+	// hypercall is `out 16, al`, which is 2 bytes long. This way we don't
+	// depend on kvm completing the IO instruction when resuming.
+	m_snapshot.regs = *m_regs;
+	m_snapshot.regs.rip += 2;
+	m_snapshot.regs.rax = 0;
+	m_snapshot.sregs = *m_sregs;
+	m_mmu.save_dirty_pages(m_snapshot.pages, m_snapshot.memory);
+
+	// Save the state that isn't in the registers or in memory
+	size_t n = SNAPSHOT_MSRS.size();
+	kvm_msrs* snapshot_msrs =
+		(kvm_msrs*)alloca(sizeof(kvm_msrs) + sizeof(kvm_msr_entry)*n);
+	snapshot_msrs->nmsrs = n;
+	for (size_t i = 0; i < n; i++)
+		snapshot_msrs->entries[i].index = SNAPSHOT_MSRS[i];
+	m_snapshot.xsave.resize(sizeof(kvm_xsave));
+	ioctl_chk(m_vcpu_fd, KVM_GET_XSAVE, m_snapshot.xsave.data());
+	ioctl_chk(m_vcpu_fd, KVM_GET_MSRS, snapshot_msrs);
+	ioctl_chk(m_vcpu_fd, KVM_GET_LAPIC, &m_snapshot.lapic);
+	m_snapshot.msrs.assign(snapshot_msrs->entries, snapshot_msrs->entries + n);
+
+	const file_t& input = m_file_contents["input"];
+	ASSERT(input_consumed <= input.length, "consumed %lu / %lu", input_consumed,
+	       input.length);
+	m_snapshot.input_prefix.assign((const char*)input.data, input_consumed);
+	m_snapshot.input_size = input.length;
+
+	// Cost of the run until now. Guest performance counters aren't reset, so
+	// instructions are counted from the end of last run.
+	kvm_msrs* msrs = (kvm_msrs*)alloca(sizeof(kvm_msrs) + sizeof(kvm_msr_entry));
+	msrs->nmsrs = 1;
+	msrs->entries[0].index = MSR_FIXED_CTR0;
+	ioctl_chk(m_vcpu_fd, KVM_GET_MSRS, msrs);
+	m_snapshot.prefix_cycles = _rdtsc() - m_run_start;
+	m_snapshot.prefix_instructions = msrs->entries[0].data -
+	                                 m_perf_counters.user_instructions;
+	m_snapshot_taken = true;
 }
 
 void Vm::handle_hypercall(RunEndReason& reason) {
@@ -191,9 +302,15 @@ void Vm::handle_hypercall(RunEndReason& reason) {
 			break;
 		case Hypercall::EndRun:
 			reason = (RunEndReason)m_regs->rdi;
-			do_hc_end_run(reason, m_regs->rsi, m_regs->rdx);
+			do_hc_end_run(reason, m_regs->rsi, m_regs->rdx, m_regs->rcx);
 			m_running = false;
 			break;
+		case Hypercall::SubmitSnapshotPointer:
+			do_hc_submit_snapshot_pointer(m_regs->rdi);
+			break;
+		case Hypercall::SnapshotPoint:
+			do_hc_snapshot_point(m_regs->rdi);
+			break;
 		default:
 			ASSERT(false, "unknown hypercall: %llu", m_regs->rax);
 	}
@@ -0,0 +1,92 @@
+#include "input_storage.h"
+#include "hash.h"
+
+using namespace std;
+
+InputStorage::InputStorage()
+	: m_free(nullptr)
+	, m_free_size(0)
+	, m_memsize(0)
+	, m_dedups(0)
+{
+}
+
+InputStorage::~InputStorage() {
+	clear();
+}
+
+char* InputStorage::alloc(size_t size) {
+	// Inputs bigger than a quarter of a chunk get their own allocation, so
+	// we don't waste the rest of the current chunk
+	if (size > CHUNK_SIZE/4) {
+		char* p = new char[size];
+		m_chunks.push_back(p);
+		return p;
+	}
+
+	// Allocate a new chunk if there's no room in the current one
+	if (size > m_free_size) {
+		m_free = new char[CHUNK_SIZE];
+		m_free_size = CHUNK_SIZE;
+		m_chunks.push_back(m_free);
+	}
+	char* p = m_free;
+	m_free += size;
+	m_free_size -= size;
+	return p;
+}
+
+InputRef InputStorage::store(const char* data, size_t size) {
+	if (size == 0)
+		return InputRef();
+
+	// Check if it's already stored
+	InputRef input(data, size);
+	uint64_t hash = hash64(data, size);
+	auto range = m_inputs.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second == input) {
+			m_dedups++;
+			return it->second;
+		}
+	}
+
+	// Copy it into our memory
+	char* p = alloc(size);
+	memcpy(p, data, size);
+	InputRef ref(p, size);
+	m_inputs.insert({hash, ref});
+	m_memsize += size;
+	return ref;
+}
+
+InputRef InputStorage::store(const string& input) {
+	return store(input.data(), input.size());
+}
+
+InputRef InputStorage::adopt(const char* data, size_t size) {
+	if (size == 0)
+		return InputRef();
+	InputRef ref(data, size);
+	m_inputs.insert({hash64(data, size), ref});
+	m_memsize += size;
+	return ref;
+}
+
+size_t InputStorage::memsize() const {
+	return m_memsize;
+}
+
+size_t InputStorage::dedups() const {
+	return m_dedups;
+}
+
+void InputStorage::clear() {
+	for (char* chunk : m_chunks)
+		delete[] chunk;
+	m_chunks.clear();
+	m_free = nullptr;
+	m_free_size = 0;
+	m_inputs.clear();
+	m_memsize = 0;
+}
@@ -1,29 +1,114 @@
 #include <iostream>
 #include <fstream>
 #include <thread>
+#include <memory>
 #include <cstring>
+#include <algorithm>
 #include "vm.h"
 #include "corpus.h"
+#include "snapshot_cache.h"
+#include "trimmer.h"
+#include "crash_minimizer.h"
+#include "work_queue.h"
+#include "stats_log.h"
+#include "sampler.h"
 #include "args.h"
 #include "utils.h"
 
 using namespace std;
 
-void print_stats(const Stats& stats, const Corpus& corpus) {
+// Format percentiles of the values recorded in a histogram
+string percentiles_str(const Histogram& hist) {
+	char buf[128];
+	snprintf(buf, sizeof(buf), "%lu/%lu/%lu/%lu", hist.percentile(0.5),
+	         hist.percentile(0.99), hist.percentile(0.999), hist.max());
+	return buf;
+}
+
+// Print exits per case by reason and by hypercall, with the fraction of the
+// cycles spent on them, and the rips with the most debug exits
+void print_exit_profile(const ExitProfile& exits, uint64_t cases,
+                        uint64_t cycles)
+{
+	printf("\texits:");
+	for (size_t i = 0; i < ExitProfile::MAX_EXIT_REASONS; i++) {
+		if (exits.exits(i))
+			printf(" %s: %.3f (%.3f)", ExitProfile::exit_reason_str(i),
+			       (double)exits.exits(i) / cases,
+			       (double)exits.exit_cycles(i) / cycles);
+	}
+	printf(", hypercalls:");
+	for (size_t i = 0; i < ExitProfile::MAX_HYPERCALLS; i++) {
+		if (exits.hypercalls(i))
+			printf(" %s: %.3f (%.3f)", Vm::hypercall_str(i),
+			       (double)exits.hypercalls(i) / cases,
+			       (double)exits.hypercall_cycles(i) / cycles);
+	}
+	printf("\n");
+
+	const size_t TOP_RIPS = 5;
+	vector<pair<uint64_t, uint64_t>> rips = exits.top_debug_rips(TOP_RIPS);
+	if (!rips.empty()) {
+		printf("\tdebug exits:");
+		for (const pair<uint64_t, uint64_t>& rip : rips)
+			printf(" 0x%lx: %.3f", rip.first, (double)rip.second / cases);
+		printf(", other: %.3f\n", (double)exits.other_debug_exits() / cases);
+	}
+}
+
+// Print the syscalls the guest kernel spent the most cycles on, with their
+// number per case and the fraction of the cycles spent on them
+void print_syscall_profile(const SyscallProfile& syscalls, uint64_t cases,
+                           uint64_t cycles)
+{
+	const size_t TOP_SYSCALLS = 5;
+	vector<size_t> top;
+	for (size_t i = 0; i < SyscallProfile::MAX_SYSCALLS; i++)
+		if (syscalls.counts[i])
+			top.push_back(i);
+	size_t n = min(TOP_SYSCALLS, top.size());
+	partial_sort(top.begin(), top.begin() + n, top.end(),
+		[&syscalls](size_t a, size_t b) {
+			return syscalls.cycles[a] > syscalls.cycles[b];
+		}
+	);
+	if (n == 0)
+		return;
+	printf("\tsyscalls:");
+	for (size_t i = 0; i < n; i++)
+		printf(" %s: %.3f (%.3f)", syscall_str(top[i]),
+		       (double)syscalls.counts[top[i]] / cases,
+		       (double)syscalls.cycles[top[i]] / cycles);
+	printf("\n");
+}
+
+// Print stats every second. If `stats_log` is given, also write them to it
+// every `log_interval` seconds.
+void print_stats(const SharedStats& shared_stats, const Corpus& corpus,
+                 StatsLog* stats_log, size_t log_interval)
+{
 	const chrono::milliseconds REFRESH_TIME {1000};
+	size_t iterations = 0;
 	chrono::duration<double> elapsed, elapsed_total, no_new_cov_time;
 	chrono::steady_clock::time_point start = chrono::steady_clock::now(),
 		new_cov_last_time = start;
 	uint64_t cycles_elapsed, cases_elapsed, cases, cov, cov_old = 0, corpus_n,
-	         crashes, unique_crashes, timeouts;
+	         favored,
+	         crashes, unique_crashes, crash_buckets, timeouts, snapshots_taken,
+	         trim_runs, trimmed_bytes;
 	double mips, fcps, run_time, reset_time, hypercall_time, corpus_mem,
 	       kvm_time, mut_time, mut1_time, mut2_time, set_input_time,
 	       reset_pages, vm_exits, vm_exits_hc, update_cov_time, report_cov_time,
-	       vm_exits_debug, vm_exits_cov;
+	       vm_exits_debug, vm_exits_cov, snapshot_hits, snapshot_time,
+	       trim_time, dup_inputs, kernel_instr, kernel_cycles, user_ipc,
+	       kernel_ipc;
 	ofstream os("stats.txt");
 	while (true) {
-		Stats stats_old = stats;
+		Stats stats_old = shared_stats.sum();
+		vector<ExitProfile> exits_old = shared_stats.exits();
 		this_thread::sleep_for(REFRESH_TIME);
+		Stats stats     = shared_stats.sum();
+		vector<ExitProfile> exits_now = shared_stats.exits();
 		auto now        = chrono::steady_clock::now();
 		elapsed         = now - start - elapsed_total;
 		elapsed_total   = now - start;
@@ -32,10 +117,16 @@ void print_stats(const Stats& stats, const Corpus& corpus) {
 		cycles_elapsed  = stats.total_cycles - stats_old.total_cycles;
 		cov             = corpus.coverage();
 		corpus_n        = corpus.size();
+		favored         = corpus.favored();
 		corpus_mem      = (double)corpus.memsize() / 1024;
 		crashes         = stats.crashes;
 		unique_crashes  = corpus.unique_crashes();
+		crash_buckets   = corpus.crash_buckets();
 		timeouts        = stats.timeouts;
+		snapshots_taken = stats.snapshots_taken;
+		trim_runs       = stats.trim_runs;
+		trimmed_bytes   = stats.trimmed_bytes;
+		snapshot_hits   = (double)(stats.snapshot_hits - stats_old.snapshot_hits) / cases_elapsed;
 		fcps            = (double)cases_elapsed / elapsed.count();
 		mips            = (double)(stats.instr - stats_old.instr) / (elapsed.count() * 1000000);
 		vm_exits        = (double)(stats.vm_exits - stats_old.vm_exits) / cases_elapsed;
@@ -53,6 +144,17 @@ void print_stats(const Stats& stats, const Corpus& corpus) {
 		mut2_time       = (double)(stats.mut2_cycles - stats_old.mut2_cycles) / cycles_elapsed;
 		update_cov_time = (double)(stats.update_cov_cycles - stats_old.update_cov_cycles) / cycles_elapsed;
 		report_cov_time = (double)(stats.report_cov_cycles - stats_old.report_cov_cycles) / cycles_elapsed;
+		snapshot_time   = (double)(stats.snapshot_cycles - stats_old.snapshot_cycles) / cycles_elapsed;
+		dup_inputs      = (double)(stats.dup_inputs - stats_old.dup_inputs) / cases_elapsed;
+		trim_time       = (double)(stats.trim_cycles - stats_old.trim_cycles) / cycles_elapsed;
+		uint64_t user_instr_elapsed    = stats.instr - stats_old.instr;
+		uint64_t kernel_instr_elapsed  = stats.kernel_instr - stats_old.kernel_instr;
+		uint64_t user_cycles_elapsed   = stats.user_cycles - stats_old.user_cycles;
+		uint64_t kernel_cycles_elapsed = stats.kernel_cycles - stats_old.kernel_cycles;
+		kernel_instr    = (double)kernel_instr_elapsed / (user_instr_elapsed + kernel_instr_elapsed);
+		kernel_cycles   = (double)kernel_cycles_elapsed / (user_cycles_elapsed + kernel_cycles_elapsed);
+		user_ipc        = (double)user_instr_elapsed / user_cycles_elapsed;
+		kernel_ipc      = (double)kernel_instr_elapsed / kernel_cycles_elapsed;
 		if (cov != cov_old)
 			new_cov_last_time = now;
 		cov_old         = cov;
@@ -63,21 +165,28 @@ void print_stats(const Stats& stats, const Corpus& corpus) {
 
 		// Free stats (no rdtsc)
 		printf("[%.3f] cases: %lu, mips: %.3f, fcps: %.3f, cov: %lu, "
-		       "corpus: %lu/%.3fKB, unique crashes: %lu (total: %lu), "
-		       "timeouts: %lu, no new cov for: %.3f\n",
+		       "corpus: %lu/%.3fKB (favored: %lu), unique crashes: %lu "
+		       "(buckets: %lu, total: %lu), timeouts: %lu, no new cov for: "
+		       "%.3f\n",
 		       elapsed_total.count(), cases, mips, fcps, cov, corpus_n,
-		       corpus_mem, unique_crashes, crashes, timeouts,
+		       corpus_mem, favored, unique_crashes, crash_buckets, crashes,
+		       timeouts,
 		       no_new_cov_time.count());
 		printf("\tvm exits: %.3f (hc: %.3f, cov: %.3f, debug: %.3f), "
-		       "reset pages: %.3f\n",
+		       "reset pages: %.3f, snapshot hits: %.3f (taken: %lu), "
+		       "trimmed: %luB (runs: %lu), dups: %.3f\n",
 		       vm_exits, vm_exits_hc, vm_exits_cov, vm_exits_debug,
-		       reset_pages);
+		       reset_pages, snapshot_hits, snapshots_taken, trimmed_bytes,
+		       trim_runs, dup_inputs);
+		printf("\tguest kernel instr: %.3f, kernel cycles: %.3f, "
+		       "ipc: %.3f (user), %.3f (kernel)\n",
+		       kernel_instr, kernel_cycles, user_ipc, kernel_ipc);
 
 		if (TIMETRACE >= 1)
 			printf("\trun: %.3f, reset: %.3f, mut: %.3f, set_input: %.3f, "
-			       "report_cov: %.3f\n",
+			       "report_cov: %.3f, snapshot: %.3f, trim: %.3f\n",
 			       run_time, reset_time, mut_time, set_input_time,
-			       report_cov_time);
+			       report_cov_time, snapshot_time, trim_time);
 
 		if (TIMETRACE >= 2) {
 			printf("\tkvm: %.3f, hc: %.3f, update_cov: %.3f, mut1: %.3f, "
@@ -86,33 +195,135 @@ void print_stats(const Stats& stats, const Corpus& corpus) {
 			       mut2_time);
 		}
 
+		// Tail latencies in the last interval, as p50/p99/p999/max
+#define X(name) stats.name.subtract(stats_old.name);
+		STATS_HISTOGRAMS(X)
+#undef X
+		printf("\tlatency cycles p50/p99/p999/max: run: %s, reset pages: %s",
+		       percentiles_str(stats.run_cycles_hist).c_str(),
+		       percentiles_str(stats.reset_pages_hist).c_str());
+		if (TIMETRACE >= 1)
+			printf(", reset: %s, mut: %s",
+			       percentiles_str(stats.reset_cycles_hist).c_str(),
+			       percentiles_str(stats.mut_cycles_hist).c_str());
+		if (TIMETRACE >= 2)
+			printf(", kvm exit: %s, hc: %s",
+			       percentiles_str(stats.kvm_cycles_hist).c_str(),
+			       percentiles_str(stats.hypercall_cycles_hist).c_str());
+		printf("\n");
+
+		// Which exits happened in the last interval, and how expensive they
+		// were
+		ExitProfile exits;
+		for (size_t i = 0; i < exits_now.size(); i++)
+			exits.add_interval(exits_now[i], exits_old[i]);
+		print_exit_profile(exits, cases_elapsed, cycles_elapsed);
+		stats.syscalls.subtract(stats_old.syscalls);
+		print_syscall_profile(stats.syscalls, cases_elapsed, cycles_elapsed);
+
 		// Print stats to file
 		os << elapsed_total.count() << " " << fcps << " " << cov << endl;
+
+		if (stats_log && ++iterations % log_interval == 0)
+			stats_log->write(shared_stats, corpus);
+	}
+}
+
+void update_schedule(Corpus& corpus) {
+	const chrono::milliseconds UPDATE_TIME {500};
+	const chrono::seconds CHECKPOINT_TIME {60};
+	chrono::steady_clock::time_point last_checkpoint = chrono::steady_clock::now();
+	while (true) {
+		this_thread::sleep_for(UPDATE_TIME);
+		corpus.update_schedule();
+
+		// Checkpoint coverage from time to time, so resuming is fast
+		auto now = chrono::steady_clock::now();
+		if (now - last_checkpoint >= CHECKPOINT_TIME) {
+			corpus.checkpoint();
+			last_checkpoint = now;
+		}
 	}
 }
 
-void worker(int id, const Vm& base, Corpus& corpus, Stats& stats) {
+// Write the samples of the guest rip every few seconds
+void write_samples(const Sampler& sampler, const string& path) {
+	const chrono::seconds WRITE_TIME {10};
+	while (true) {
+		this_thread::sleep_for(WRITE_TIME);
+		sampler.write_folded(path);
+	}
+}
+
+void worker(int id, const Vm& base, Corpus& corpus, SharedStats& stats,
+            Sampler* sampler, size_t snapshot_cache_memsize, bool trim,
+            uint64_t seed)
+{
 	// The vm we'll be running
 	Vm runner(base);
 
-	// Custom RNG: avoids locks and it's simpler
-	Rng rng;
+	// Snapshots of hot corpus elements, and snapshot taken in last run
+	SnapshotCache snapshots(snapshot_cache_memsize);
+	Snapshot snapshot;
+
+	// Trimmer for inputs with new coverage, the trimmed input, and its
+	// coverage and read info
+	unique_ptr<Trimmer> trimmer;
+	if (trim)
+		trimmer.reset(new Trimmer(base, corpus.max_input_size()));
+	string trimmed_input;
+	trimmed_input.reserve(corpus.max_input_size());
+	Coverage trimmed_cov;
+	InputReadInfo trimmed_read_info;
+
+	// Custom RNG: avoids locks and it's simpler. Each thread gets a
+	// different seed derived from the given one
+	Rng rng(seed + id);
 
 	// Timetracing
 	cycle_t cycles_init, cycles;
 
+	// Cost of each run, used by the scheduler. Measured even without
+	// timetracing
+	ExecInfo exec_info;
+
 	Vm::RunEndReason reason;
 
+	// Stats of this thread, published from time to time
+	Stats local_stats;
+
+	// Rips sampled by the guest, handed to the sampler from time to time
+	vector<vaddr_t> samples;
+
 	while (true) {
-		Stats local_stats;
 		cycles_init = _rdtsc();
 
 		// Run some time saving stats locally
 		while (_rdtsc() - cycles_init < 50000000) {
 			// Get new input
 			cycles = rdtsc1();
-			const string& input = corpus.get_new_input(id, rng, stats);
-			local_stats.mut_cycles += rdtsc1() - cycles;
+			const string& input = corpus.get_new_input(id, rng, local_stats);
+			cycles = rdtsc1() - cycles;
+			local_stats.mut_cycles += cycles;
+			if (TIMETRACE >= 1)
+				local_stats.mut_cycles_hist.record(cycles);
+
+			// If we have a snapshot of the element the input was mutated
+			// from, and it's valid for this input, resume from there.
+			// Otherwise, ask for a snapshot if that element is hot.
+			cycles = rdtsc1();
+			size_t i = corpus.mutated_input_index(id);
+			const Snapshot* cached = nullptr;
+			if (snapshots.enabled()) {
+				cached = snapshots.get(i, input);
+				if (cached) {
+					runner.restore_snapshot(*cached);
+					local_stats.snapshot_hits++;
+				} else if (snapshots.wants_snapshot(i)) {
+					runner.request_snapshot(corpus.mutated_input_offset(id));
+				}
+			}
+			local_stats.snapshot_cycles += rdtsc1() - cycles;
 
 			// Update input
 			cycles = rdtsc1();
@@ -120,42 +331,202 @@ void worker(int id, const Vm& base, Corpus& corpus, Stats& stats) {
 			local_stats.set_input_cycles += rdtsc1() - cycles;
 
 			// Perform run
-			cycles = rdtsc1();
+			cycles = _rdtsc();
 			reason = runner.run(local_stats);
-			local_stats.run_cycles += rdtsc1() - cycles;
+			exec_info.cycles = _rdtsc() - cycles;
+			PerfCounters perf = runner.perf_counters_last_run();
+			exec_info.instructions = perf.user_instructions;
+			exec_info.timeout = (reason == Vm::RunEndReason::Timeout);
+			local_stats.run_cycles += exec_info.cycles;
+			local_stats.run_cycles_hist.record(exec_info.cycles);
 			local_stats.cases++;
-			local_stats.instr += runner.instructions_executed_last_run();
+			local_stats.instr += exec_info.instructions;
+			local_stats.kernel_instr += perf.kernel_instructions;
+			local_stats.user_cycles += perf.user_cycles;
+			local_stats.kernel_cycles += perf.kernel_cycles;
+
+			// A run resumed from a snapshot skipped the prefix. Add its cost,
+			// so the scheduler doesn't see the input as cheaper than it is.
+			if (cached) {
+				exec_info.cycles += cached->prefix_cycles;
+				exec_info.instructions += cached->prefix_instructions;
+			}
 
 			// Check RunEndReason
 			if (reason == Vm::RunEndReason::Crash) {
-				stats.crashes++;
-				corpus.report_crash(id, runner.fault());
+				local_stats.crashes++;
+				// Coverage of a run without its whole path would give
+				// different paths for the same crash
+				uint64_t path = (Coverage::HAS_PATHS ?
+				                 runner.coverage().fingerprint() : 0);
+				corpus.report_crash(id, runner.fault(), path);
 			} else if (reason == Vm::RunEndReason::Timeout) {
-				stats.timeouts++;
+				local_stats.timeouts++;
 			} else if (reason != Vm::RunEndReason::Exit) {
 				die("unexpected RunEndReason: %s\n", Vm::reason_str[reason]);
 			}
 
 			// Report coverage
 			cycles = rdtsc1();
-			corpus.report_coverage(id, runner.coverage());
-			runner.reset_coverage();
+			bool new_cov = corpus.report_coverage(id, runner.coverage());
 			local_stats.report_cov_cycles += rdtsc1() - cycles;
 
+			// If there was new coverage, trim the input and add it to corpus
+			if (new_cov) {
+				cycles = rdtsc1();
+				trimmed_input.assign(input);
+				trimmed_cov = runner.coverage();
+				trimmed_read_info = runner.input_read_info();
+				if (trimmer) {
+					local_stats.trim_runs += trimmer->trim(trimmed_input,
+					                                       trimmed_cov,
+					                                       trimmed_read_info);
+					local_stats.trimmed_bytes += input.size() -
+					                             trimmed_input.size();
+				}
+				corpus.add_new_input(id, trimmed_input, trimmed_cov,
+				                     trimmed_read_info, exec_info);
+				local_stats.trim_cycles += rdtsc1() - cycles;
+			}
+			runner.reset_coverage();
+
+			// Save the snapshot taken in this run, if any
+			cycles = rdtsc1();
+			if (runner.pop_snapshot(snapshot)) {
+				snapshots.insert(i, snapshot);
+				local_stats.snapshots_taken++;
+			}
+			local_stats.snapshot_cycles += rdtsc1() - cycles;
+
 			// Reset vm
 			cycles = rdtsc1();
 			runner.reset(base, local_stats);
-			local_stats.reset_cycles += rdtsc1() - cycles;
+			cycles = rdtsc1() - cycles;
+			local_stats.reset_cycles += cycles;
+			if (TIMETRACE >= 1)
+				local_stats.reset_cycles_hist.record(cycles);
 
 			dbgprintf("run ended!\n\n");
 		}
-		local_stats.total_cycles = _rdtsc() - cycles_init;
+		local_stats.total_cycles += _rdtsc() - cycles_init;
+
+		// Publish stats
+		local_stats.syscalls = runner.syscall_profile();
+		stats.publish(id, local_stats);
+
+		// Hand samples to the sampler
+		if (sampler) {
+			uint64_t lost = runner.pop_samples(samples);
+			sampler->add(samples, lost);
+			samples.clear();
+		}
+	}
+}
+
+void bind_to_core(thread& t, int i) {
+	cpu_set_t cpu;
+	CPU_ZERO(&cpu);
+	CPU_SET(i % thread::hardware_concurrency(), &cpu);
+	int ret = pthread_setaffinity_np(t.native_handle(), sizeof(cpu), &cpu);
+	ASSERT(ret == 0, "Binding thread to core %d: %s", i, strerror(ret));
+}
 
-		// Update global stats
-		stats.update(local_stats);
+// Result of running a seed input
+struct SeedResult {
+	Vm::RunEndReason reason;
+	Coverage coverage;
+	FaultInfo fault;
+	InputReadInfo read_info;
+	ExecInfo exec_info;
+};
+
+void triage_worker(int id, const Vm& base, const Corpus& corpus,
+                   WorkQueue& queue, vector<SeedResult>& results)
+{
+	Vm runner(base);
+	Stats stats;
+	string input;
+	cycle_t cycles;
+	size_t i;
+	while (queue.pop(id, i)) {
+		SeedResult& result = results[i];
+		input = corpus.element(i).str();
+		runner.set_input(input);
+		cycles = _rdtsc();
+		result.reason = runner.run(stats);
+		cycles = _rdtsc() - cycles;
+		result.exec_info = { cycles, runner.instructions_executed_last_run(),
+		                     result.reason == Vm::RunEndReason::Timeout };
+		result.coverage  = runner.coverage();
+		result.read_info = runner.input_read_info();
+		if (result.reason == Vm::RunEndReason::Crash)
+			result.fault = runner.fault();
+		runner.reset_coverage();
+		runner.reset(base, stats);
 	}
 }
 
+// Run every seed input in parallel with `nthreads` threads, each with its own
+// copy of `base`, and get the results in the order of the corpus. Each thread
+// runs a part of the seeds, and when it's done it steals seeds from others.
+void triage_seeds(const Vm& base, const Corpus& corpus, int nthreads,
+                  vector<SeedResult>& results)
+{
+	nthreads = min((size_t)nthreads, corpus.size());
+	results.resize(corpus.size());
+	WorkQueue queue(nthreads, corpus.size());
+	vector<thread> threads;
+	for (int i = 0; i < nthreads; i++) {
+		thread t = thread(triage_worker, i, ref(base), ref(corpus), ref(queue),
+		                  ref(results));
+		bind_to_core(t, i);
+		threads.push_back(move(t));
+	}
+	for (thread& t : threads)
+		t.join();
+
+	size_t crashes = 0, timeouts = 0;
+	for (const SeedResult& result : results) {
+		crashes  += (result.reason == Vm::RunEndReason::Crash);
+		timeouts += (result.reason == Vm::RunEndReason::Timeout);
+	}
+	printf("Ran %lu seed inputs with %d threads: %lu crashes, %lu timeouts\n",
+	       results.size(), nthreads, crashes, timeouts);
+}
+
+// Minimize every crash in the corpus, one after another. The candidates of
+// each minimization step are run in parallel by `nthreads` threads.
+void minimize_crashes(const Vm& base, Corpus& corpus,
+                      const vector<FaultInfo>& faults, int nthreads)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	CrashMinimizer minimizer(base, nthreads);
+	vector<thread> threads;
+	for (int i = 0; i < nthreads; i++) {
+		thread t = thread(&CrashMinimizer::work, &minimizer);
+		bind_to_core(t, i);
+		threads.push_back(move(t));
+	}
+
+	string input;
+	for (size_t i = 0; i < corpus.size(); i++) {
+		input = corpus.element(i).str();
+		CrashMinimizer::Profile profile = minimizer.minimize(input, faults[i]);
+		corpus.set_minimized_crash(i, input);
+		printf("Minimized '%s': %lu -> %lu bytes. Removal: %lu runs, %.3fs. "
+		       "Canonicalization: %lu runs, %.3fs\n",
+		       corpus.seed_filename(i).c_str(), profile.initial_size,
+		       profile.final_size, profile.removal_runs, profile.removal_time,
+		       profile.canonicalization_runs, profile.canonicalization_time);
+	}
+
+	minimizer.stop();
+	for (thread& t : threads)
+		t.join();
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	printf("Minimized %lu crashes in %.3fs\n", corpus.size(), elapsed.count());
+}
+
 void read_and_set_file(const string& filename, Vm& vm) {
 	static vector<string> file_contents;
 	string content = read_file(filename);
@@ -171,8 +542,9 @@ int main(int argc, char** argv) {
 	setvbuf(stdout, nullptr, _IONBF, 0);
 	setvbuf(stderr, nullptr, _IONBF, 0);
 	cout << "Number of threads: " << args.jobs << endl;
+	printf("Seed: %lu\n", args.seed);
 	Stats stats;
-	Corpus corpus(args.jobs, args.input_dir, args.output_dir);
+	Corpus corpus(args.jobs, args.input_dir, args.output_dir, args.schedule);
 	Vm vm(
 		args.memory,
 		args.kernel_path,
@@ -202,11 +574,19 @@ int main(int argc, char** argv) {
 		read_and_set_file(path, vm);
 	}
 
+	// Sampling must be set before the kernel starts
+	vm.set_sample_interval(args.sample_interval);
+
 	// Run until main before forking or running single input
 	// vm.run_until(vm.elf().entry(), stats);
 	// vm.run_until(vm.elf().load_addr() + 0x7640, stats);
 	vm.run_until(vm.resolve_symbol("main"), stats);
 
+	// Libraries are loaded now. Write the symbols of the guest, so it can be
+	// profiled from the host
+	vm.load_libraries();
+	vm.write_symbol_maps(args.output_dir + "/guest_symbols");
+
 	// Reset timer so it starts counting from 0, and set specified timeout
 	vm.reset_timer();
 	vm.set_timeout(args.timeout);
@@ -232,6 +612,23 @@ int main(int argc, char** argv) {
 		if (reason == Vm::RunEndReason::Crash)
 			cout << vm.fault() << endl;
 		printf("Run ended with reason %s\n", Vm::reason_str[reason]);
+
+		// Print instructions and cycles in each ring, and append them to a
+		// file for scripts/instructions.plt
+		PerfCounters perf = vm.perf_counters_last_run();
+		printf("Instructions: %lu user, %lu kernel. Cycles: %lu user, "
+		       "%lu kernel\n", perf.user_instructions, perf.kernel_instructions,
+		       perf.user_cycles, perf.kernel_cycles);
+		const char* instr_path = "stats_instructions.txt";
+		bool instr_header = access(instr_path, F_OK) != 0;
+		ofstream instr_os(instr_path, ios::app);
+		if (instr_header)
+			instr_os << "run user kernel user_cycles kernel_cycles" << endl;
+		instr_os << '"' << args.binary_path << " "
+		         << args.single_run_input_path << '"' << " "
+		         << perf.user_instructions << " " << perf.kernel_instructions
+		         << " " << perf.user_cycles << " " << perf.kernel_cycles
+		         << endl;
 		// vm.dump("libtiff-data");
 		return 0;
 	}
@@ -248,12 +645,11 @@ int main(int argc, char** argv) {
 		vm.set_breakpoints_dirty(true);
 
 		// Get coverage of every input and submit it to corpus
+		vector<SeedResult> results;
+		triage_seeds(vm, corpus, args.jobs, results);
 		vector<Coverage> coverages;
-		Vm runner(vm);
-		Vm::RunEndReason reason;
 		for (size_t i = 0; i < corpus.size(); i++) {
-			runner.set_input(corpus.element(i));
-			reason = runner.run(stats);
+			Vm::RunEndReason reason = results[i].reason;
 			if (reason == Vm::RunEndReason::Crash) {
 				printf("Input file '%s' crashed in corpus minimization mode\n",
 				       corpus.seed_filename(i).c_str());
@@ -261,53 +657,89 @@ int main(int argc, char** argv) {
 				die("unexpected RunEndReason for input '%s': %s\n",
 				    corpus.seed_filename(i).c_str(), Vm::reason_str[reason]);
 			}
-			coverages.push_back(runner.coverage());
-			runner.reset_coverage();
-			runner.reset(vm, stats);
+			coverages.push_back(results[i].coverage);
 		}
 		corpus.set_mode_corpus_min(coverages);
 #endif
 
 	} else if (args.minimize_crashes) {
 		// Make sure every input actually crashes, and submit faults to corpus
+		vector<SeedResult> results;
+		triage_seeds(vm, corpus, args.jobs, results);
 		vector<FaultInfo> faults;
-		Vm runner(vm);
-		Vm::RunEndReason reason;
 		for (size_t i = 0; i < corpus.size(); i++) {
-			runner.set_input(corpus.element(i));
-			reason = runner.run(stats);
-			ASSERT(reason == Vm::RunEndReason::Crash, "input '%s' didn't crash",
-			       corpus.seed_filename(i).c_str());
-			faults.push_back(runner.fault());
-			runner.reset(vm, stats);
+			ASSERT(results[i].reason == Vm::RunEndReason::Crash,
+			       "input '%s' didn't crash", corpus.seed_filename(i).c_str());
+			faults.push_back(results[i].fault);
 		}
 		corpus.set_mode_crashes_min(faults);
 
+		// Minimize them with delta debugging. There's no need to keep fuzzing
+		// after that
+		minimize_crashes(vm, corpus, faults, args.jobs);
+		return 0;
+
+	} else if (corpus.resumed()) {
+		// Corpus was read from the pack of a previous campaign, which has the
+		// coverage and cost of each input, so there's no need to run them
+		corpus.set_mode_normal_resumed();
+
 	} else {
-		// Perform run with each seed input and submit total coverage to corpus
-		Vm runner(vm);
-		for (size_t i = 0; i < corpus.size(); i++) {
-			runner.set_input(corpus.element(i));
-			runner.run(stats);
-			runner.reset(vm, stats);
+		// Perform run with each seed input and submit its coverage, the
+		// parts of it that were read and its cost to corpus
+		vector<SeedResult> results;
+		triage_seeds(vm, corpus, args.jobs, results);
+		vector<Coverage> coverages;
+		vector<InputReadInfo> read_infos;
+		vector<ExecInfo> exec_infos;
+		for (const SeedResult& result : results) {
+			coverages.push_back(result.coverage);
+			read_infos.push_back(result.read_info);
+			exec_infos.push_back(result.exec_info);
 		}
-		corpus.set_mode_normal(runner.coverage());
+		corpus.set_mode_normal(coverages, read_infos, exec_infos);
 	}
 
 
+	// Snapshots are only used in normal mode. Corpus minimization needs
+	// breakpoints that dirty memory, and its inputs change all the time.
+	// Intel PT traces only what was executed, so the coverage of a run
+	// resumed from a snapshot would lack the edges of the prefix. Trimming is
+	// also done only in normal mode, as it's the only one that adds inputs to
+	// the corpus.
+	size_t snapshot_cache_memsize = 0;
+	bool trim = false;
+	if (!args.minimize_corpus) {
+#ifndef ENABLE_COVERAGE_INTEL_PT
+		snapshot_cache_memsize = args.snapshot_cache / args.jobs;
+#endif
+		trim = !args.no_trim;
+	}
+
 	// Create threads and bind each one to a core
 	printf("Creating threads...\n");
-	cpu_set_t cpu;
+	SharedStats shared_stats(args.jobs);
+	unique_ptr<Sampler> sampler;
+	if (args.sample_interval)
+		sampler.reset(new Sampler(vm.elfs()));
 	vector<thread> threads;
 	for (int i = 0; i < args.jobs; i++) {
-		thread t = thread(worker, i, ref(vm), ref(corpus), ref(stats));
-		CPU_ZERO(&cpu);
-		CPU_SET(i % thread::hardware_concurrency(), &cpu);
-		int ret = pthread_setaffinity_np(t.native_handle(), sizeof(cpu), &cpu);
-		ASSERT(ret == 0, "Binding thread to core %d: %s", i, strerror(ret));
+		thread t = thread(worker, i, ref(vm), ref(corpus), ref(shared_stats),
+		                  sampler.get(), snapshot_cache_memsize, trim,
+		                  args.seed);
+		bind_to_core(t, i);
 		threads.push_back(move(t));
 	}
-	threads.push_back(thread(print_stats, ref(stats), ref(corpus)));
+	unique_ptr<StatsLog> stats_log;
+	if (args.stats_interval)
+		stats_log.reset(new StatsLog(args.output_dir + "/stats.jsonl", args.jobs));
+	threads.push_back(thread(print_stats, ref(shared_stats), ref(corpus),
+	                         stats_log.get(), args.stats_interval));
+	if (!args.minimize_corpus)
+		threads.push_back(thread(update_schedule, ref(corpus)));
+	if (sampler)
+		threads.push_back(thread(write_samples, cref(*sampler),
+		                         args.output_dir + "/samples.folded"));
 
 	for (thread& t : threads)
 		t.join();
@@ -2,6 +2,8 @@
 #include <fstream>
 #include <sys/mman.h>
 #include <cstring>
+#include <algorithm>
+#include <new>
 #include "mmu.h"
 #include "page_walker.h"
 #include "kvm_aux.h"
@@ -15,6 +17,9 @@ Mmu::Mmu(int vm_fd, int vcpu_fd, size_t mem_size)
 	, m_memory((uint8_t*)mmap(nullptr, mem_size, PROT_READ|PROT_WRITE,
 	                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0))
 	, m_length(mem_size)
+	, m_shared_mem((SharedMem*)mmap(nullptr, SHARED_MEM_SIZE,
+	                                PROT_READ|PROT_WRITE,
+	                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0))
 	, m_ptl4(PAGE_TABLE_PADDR)
 	, m_can_alloc(true)
 	, m_next_page_alloc(PAGE_TABLE_PADDR + 0x1000)
@@ -32,6 +37,7 @@ Mmu::Mmu(int vm_fd, int vcpu_fd, size_t mem_size)
 {
 	ASSERT((m_length % PAGE_SIZE) == 0, "not page-aligned memory length");
 	ERROR_ON(m_memory == MAP_FAILED, "mmap mmu memory");
+	ERROR_ON(m_shared_mem == MAP_FAILED, "mmap shared memory");
 #ifdef ENABLE_KVM_DIRTY_LOG_RING
 	ERROR_ON(m_dirty_ring == MAP_FAILED, "mmap dirty log ring");
 #else
@@ -49,10 +55,21 @@ Mmu::Mmu(int vm_fd, int vcpu_fd, size_t mem_size)
 	};
 	ioctl_chk(m_vm_fd, KVM_SET_USER_MEMORY_REGION, &memreg);
 
-	// Map all physical memory. This is needed for guest kernel to access page
-	// tables and other physical addresses.
+	// Shared memory goes right after physical memory, without dirty logging
+	new (m_shared_mem) SharedMem();
+	struct kvm_userspace_memory_region shared_memreg = {
+		.slot = 1,
+		.flags = 0,
+		.guest_phys_addr = mem_size,
+		.memory_size = SHARED_MEM_SIZE,
+		.userspace_addr = (unsigned long)m_shared_mem
+	};
+	ioctl_chk(m_vm_fd, KVM_SET_USER_MEMORY_REGION, &shared_memreg);
+
+	// Map all physical memory, including shared memory. This is needed for
+	// guest kernel to access page tables and other physical addresses.
 	PageWalker pages(PHYSMAP_ADDR, *this);
-	for (paddr_t p = 0; p < m_length; p += PAGE_SIZE) {
+	for (paddr_t p = 0; p < m_length + SHARED_MEM_SIZE; p += PAGE_SIZE) {
 		pages.map(p, PDE64_PRESENT | PDE64_RW);
 		pages.next();
 	}
@@ -95,6 +112,7 @@ Mmu::Mmu(int vm_fd, int vcpu_fd, const Mmu& other)
 
 Mmu::~Mmu() {
 	munmap(m_memory, m_length);
+	munmap(m_shared_mem, SHARED_MEM_SIZE);
 #ifdef ENABLE_KVM_DIRTY_LOG_RING
 	munmap(m_dirty_ring, m_dirty_ring_entries * sizeof(kvm_dirty_gfn));
 #else
@@ -114,6 +132,18 @@ void Mmu::disable_allocations() {
 	m_can_alloc = false;
 }
 
+SharedMem& Mmu::shared_mem() {
+	return *m_shared_mem;
+}
+
+const SharedMem& Mmu::shared_mem() const {
+	return *m_shared_mem;
+}
+
+vaddr_t Mmu::shared_mem_vaddr() const {
+	return PHYSMAP_ADDR + m_length;
+}
+
 __attribute__((always_inline)) static inline
 void custom_memcpy(void* to, void* from, size_t len) {
 	asm volatile(
@@ -203,6 +233,58 @@ size_t Mmu::reset(const Mmu& other) {
 	return count;
 }
 
+void Mmu::save_dirty_pages(vector<paddr_t>& pages, vector<uint8_t>& memory) {
+	// Move every page marked as dirty by kvm to `m_dirty_extra`, as we are
+	// clearing the log and they must be restored in next reset
+#ifdef ENABLE_KVM_DIRTY_LOG_RING
+	while (m_dirty_ring[m_dirty_ring_i].flags & KVM_DIRTY_GFN_F_DIRTY) {
+		m_dirty_extra.push_back(m_dirty_ring[m_dirty_ring_i].offset * PAGE_SIZE);
+		m_dirty_ring[m_dirty_ring_i].flags |= KVM_DIRTY_GFN_F_RESET;
+		m_dirty_ring_i = (m_dirty_ring_i+1)% m_dirty_ring_entries;
+	}
+	ioctl_chk(m_vm_fd, KVM_RESET_DIRTY_RINGS, 0);
+#else
+	kvm_dirty_log dirty = {
+		.slot = 0,
+		.dirty_bitmap = m_dirty_bitmap
+	};
+	ioctl_chk(m_vm_fd, KVM_GET_DIRTY_LOG, &dirty);
+
+	size_t dirty_words = m_dirty_bits/(8*sizeof(size_t));
+	for (size_t i = 0; i < dirty_words; i++) {
+		size_t dirty_word = ((size_t*)m_dirty_bitmap)[i];
+		while (dirty_word) {
+			size_t bit = __builtin_ctzl(dirty_word);
+			m_dirty_extra.push_back((i*8*sizeof(size_t) + bit)*PAGE_SIZE);
+			dirty_word &= dirty_word - 1;
+		}
+	}
+	memset(m_dirty_bitmap, 0, m_dirty_bits/8);
+#endif
+
+	// Remove duplicates, so each page is saved and restored only once
+	sort(m_dirty_extra.begin(), m_dirty_extra.end());
+	m_dirty_extra.erase(unique(m_dirty_extra.begin(), m_dirty_extra.end()),
+	                    m_dirty_extra.end());
+
+	// Save pages
+	pages = m_dirty_extra;
+	memory.resize(pages.size() * PAGE_SIZE);
+	for (size_t i = 0; i < pages.size(); i++)
+		memcpy(&memory[i*PAGE_SIZE], m_memory + pages[i], PAGE_SIZE);
+}
+
+void Mmu::restore_pages(const vector<paddr_t>& pages,
+                        const vector<uint8_t>& memory)
+{
+	ASSERT(memory.size() == pages.size() * PAGE_SIZE, "bad saved pages");
+	for (size_t i = 0; i < pages.size(); i++) {
+		ASSERT(pages[i] + PAGE_SIZE <= m_length, "OOB: 0x%lx", pages[i]);
+		memcpy(m_memory + pages[i], &memory[i*PAGE_SIZE], PAGE_SIZE);
+		m_dirty_extra.push_back(pages[i]);
+	}
+}
+
 paddr_t Mmu::alloc_frame() {
 	ASSERT(m_can_alloc, "attempt to allocate frame when we can't");
 	ASSERT(m_next_page_alloc <= m_length - PAGE_SIZE, "OOM");
@@ -0,0 +1,188 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pack_file.h"
+
+using namespace std;
+
+static void pwrite_all(int fd, const void* buf, size_t size, size_t offset) {
+	const char* p = (const char*)buf;
+	while (size) {
+		ssize_t ret = pwrite(fd, p, size, offset);
+		ERROR_ON(ret == -1, "writing pack file");
+		p += ret;
+		size -= ret;
+		offset += ret;
+	}
+}
+
+static size_t file_size(int fd) {
+	struct stat st;
+	ERROR_ON(fstat(fd, &st) == -1, "fstat pack file");
+	return st.st_size;
+}
+
+static size_t align8(size_t n) {
+	return (n + 7) & ~7;
+}
+
+PackFile::PackFile(const string& path)
+	: m_index(nullptr)
+	, m_index_map_size(0)
+	, m_records(nullptr)
+	, m_data(nullptr)
+	, m_data_map_size(0)
+{
+	string index_path = path + INDEX_EXT;
+	string data_path  = path + DATA_EXT;
+	m_index_fd = open(index_path.c_str(), O_RDWR);
+	ERROR_ON(m_index_fd == -1, "opening pack index %s", index_path.c_str());
+	m_data_fd = open(data_path.c_str(), O_RDWR);
+	ERROR_ON(m_data_fd == -1, "opening pack data %s", data_path.c_str());
+
+	// Map the index and check the header
+	size_t index_size = file_size(m_index_fd);
+	ASSERT(index_size >= sizeof(Header), "bad pack index: %s",
+	       index_path.c_str());
+	m_index_map_size = index_size;
+	void* p = mmap(nullptr, m_index_map_size, PROT_READ, MAP_PRIVATE,
+	               m_index_fd, 0);
+	ERROR_ON(p == MAP_FAILED, "mmap pack index");
+	m_index = (const char*)p;
+	const Header* header = (const Header*)m_index;
+	ASSERT(header->magic == MAGIC && header->record_size == sizeof(Record),
+	       "bad pack index: %s", index_path.c_str());
+	m_max_input_size = header->max_input_size;
+	m_records = (const Record*)(m_index + sizeof(Header));
+
+	// Discard the records at the end that are incomplete or whose blobs
+	// weren't completely written, and truncate the files so appending
+	// continues from the last complete entry
+	size_t data_size = file_size(m_data_fd);
+	size_t n = (index_size - sizeof(Header)) / sizeof(Record);
+	while (n > 0) {
+		const Record& last = m_records[n-1];
+		if (last.coverage_offset + last.coverage_size*sizeof(uint64_t) <= data_size)
+			break;
+		n--;
+	}
+	m_size = m_mapped_size = n;
+	m_data_size = 0;
+	if (n > 0) {
+		const Record& last = m_records[n-1];
+		m_data_size = last.coverage_offset + last.coverage_size*sizeof(uint64_t);
+	}
+	ERROR_ON(ftruncate(m_index_fd, sizeof(Header) + n*sizeof(Record)) == -1,
+	         "truncating pack index");
+	ERROR_ON(ftruncate(m_data_fd, m_data_size) == -1, "truncating pack data");
+
+	// Map the data
+	if (m_data_size) {
+		m_data_map_size = m_data_size;
+		p = mmap(nullptr, m_data_map_size, PROT_READ, MAP_PRIVATE, m_data_fd, 0);
+		ERROR_ON(p == MAP_FAILED, "mmap pack data");
+		m_data = (const char*)p;
+	}
+}
+
+PackFile::PackFile(const string& path, size_t max_input_size)
+	: m_index(nullptr)
+	, m_index_map_size(0)
+	, m_records(nullptr)
+	, m_data(nullptr)
+	, m_data_map_size(0)
+	, m_mapped_size(0)
+	, m_size(0)
+	, m_data_size(0)
+	, m_max_input_size(max_input_size)
+{
+	string index_path = path + INDEX_EXT;
+	string data_path  = path + DATA_EXT;
+	m_index_fd = open(index_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ERROR_ON(m_index_fd == -1, "creating pack index %s", index_path.c_str());
+	m_data_fd = open(data_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ERROR_ON(m_data_fd == -1, "creating pack data %s", data_path.c_str());
+
+	Header header = {
+		.magic          = MAGIC,
+		.record_size    = sizeof(Record),
+		.max_input_size = max_input_size,
+		.reserved       = 0,
+	};
+	pwrite_all(m_index_fd, &header, sizeof(header), 0);
+}
+
+PackFile::~PackFile() {
+	if (m_index)
+		munmap((void*)m_index, m_index_map_size);
+	if (m_data)
+		munmap((void*)m_data, m_data_map_size);
+	close(m_index_fd);
+	close(m_data_fd);
+}
+
+bool PackFile::exists(const string& path) {
+	return access((path + INDEX_EXT).c_str(), F_OK) == 0;
+}
+
+size_t PackFile::size() const {
+	return m_size;
+}
+
+size_t PackFile::max_input_size() const {
+	return m_max_input_size;
+}
+
+size_t PackFile::mapped_size() const {
+	return m_mapped_size;
+}
+
+const PackFile::Record& PackFile::record(size_t i) const {
+	ASSERT(i < m_mapped_size, "OOB i: %lu/%lu", i, m_mapped_size);
+	return m_records[i];
+}
+
+InputRef PackFile::input(size_t i) const {
+	const Record& rec = record(i);
+	if (rec.input_size == 0)
+		return InputRef();
+	return InputRef(m_data + rec.input_offset, rec.input_size);
+}
+
+const uint64_t* PackFile::coverage(size_t i) const {
+	return (const uint64_t*)(m_data + record(i).coverage_offset);
+}
+
+void PackFile::append(const char* input, size_t size,
+                      const vector<uint64_t>& coverage, uint64_t path,
+                      size_t depth, const ExecInfo& exec_info,
+                      const InputReadInfo& read_info)
+{
+	Record rec;
+	rec.input_offset    = m_data_size;
+	rec.input_size      = size;
+	rec.coverage_offset = align8(m_data_size + size);
+	rec.coverage_size   = coverage.size();
+	rec.path            = path;
+	rec.depth           = depth;
+	rec.exec_info       = exec_info;
+	rec.read_info       = read_info;
+
+	// Write the blobs, padding the input so the coverage keys are aligned,
+	// and then the record
+	static const char padding[8] = {};
+	pwrite_all(m_data_fd, input, size, rec.input_offset);
+	pwrite_all(m_data_fd, padding, rec.coverage_offset - rec.input_offset - size,
+	           rec.input_offset + size);
+	pwrite_all(m_data_fd, coverage.data(), coverage.size()*sizeof(uint64_t),
+	           rec.coverage_offset);
+	pwrite_all(m_index_fd, &rec, sizeof(rec),
+	           sizeof(Header) + m_size*sizeof(Record));
+	m_data_size = rec.coverage_offset + coverage.size()*sizeof(uint64_t);
+	m_size++;
+}
+
+void PackFile::sync() {
+	ERROR_ON(fdatasync(m_data_fd) == -1, "syncing pack data");
+	ERROR_ON(fdatasync(m_index_fd) == -1, "syncing pack index");
+}
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include "sampler.h"
+
+using namespace std;
+
+Sampler::Sampler(const vector<const ElfParser*>& elfs)
+	: m_lost(0)
+{
+	for (const ElfParser* elf : elfs) {
+		string module = elf->name();
+		for (const symbol_t& symbol : elf->function_symbols()) {
+			m_functions.push_back({symbol.value, symbol.value + symbol.size,
+			                       module + ";" + symbol.name});
+		}
+	}
+
+	// Sort functions and remove aliases, which have the same start address
+	sort(m_functions.begin(), m_functions.end(),
+		[](const Function& a, const Function& b) {
+			return a.start < b.start;
+		}
+	);
+	auto it = unique(m_functions.begin(), m_functions.end(),
+		[](const Function& a, const Function& b) {
+			return a.start == b.start;
+		}
+	);
+	m_functions.erase(it, m_functions.end());
+	m_counts.resize(m_functions.size() + 1);
+}
+
+size_t Sampler::function_index(vaddr_t rip) const {
+	auto it = upper_bound(m_functions.begin(), m_functions.end(), rip,
+		[](vaddr_t rip, const Function& function) {
+			return rip < function.start;
+		}
+	);
+	if (it == m_functions.begin() || rip >= (it-1)->end)
+		return m_functions.size();
+	return it - m_functions.begin() - 1;
+}
+
+void Sampler::add(const vector<vaddr_t>& rips, uint64_t lost) {
+	lock_guard<mutex> lock(m_mutex);
+	for (vaddr_t rip : rips)
+		m_counts[function_index(rip)]++;
+	m_lost += lost;
+}
+
+void Sampler::write_folded(const string& path) const {
+	FILE* file = fopen(path.c_str(), "w");
+	ERROR_ON(!file, "opening samples file %s", path.c_str());
+
+	lock_guard<mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_functions.size(); i++)
+		if (m_counts[i])
+			fprintf(file, "%s %lu\n", m_functions[i].name.c_str(), m_counts[i]);
+	if (m_counts.back())
+		fprintf(file, "[unknown] %lu\n", m_counts.back());
+	if (m_lost)
+		fprintf(file, "[lost] %lu\n", m_lost);
+	fclose(file);
+}
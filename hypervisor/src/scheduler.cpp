@@ -0,0 +1,300 @@
+#include <cmath>
+#include <sys/mman.h>
+#include "scheduler.h"
+
+using namespace std;
+
+const char* Scheduler::schedule_str[] = {
+	"explore",
+	"fast",
+	"rare",
+};
+
+template <class T>
+static T* alloc_array(size_t n) {
+	// Anonymous memory is zeroed and it's not used until it's touched
+	void* p = mmap(nullptr, n*sizeof(T), PROT_READ|PROT_WRITE,
+	               MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+	ERROR_ON(p == MAP_FAILED, "mmap scheduler metadata");
+	return (T*)p;
+}
+
+template <class T>
+static void free_array(T* p, size_t n) {
+	munmap(p, n*sizeof(T));
+}
+
+Scheduler::Scheduler(int nthreads, Schedule schedule)
+	: m_schedule(schedule)
+	, m_exec_cycles(alloc_array<atomic<uint64_t>>(MAX_ENTRIES))
+	, m_size(alloc_array<atomic<uint64_t>>(MAX_ENTRIES))
+	, m_instructions(alloc_array<atomic<uint64_t>>(MAX_ENTRIES))
+	, m_times_selected(alloc_array<atomic<uint64_t>>(MAX_ENTRIES))
+	, m_coverage_found(alloc_array<atomic<uint64_t>>(MAX_ENTRIES))
+	, m_depth(alloc_array<atomic<uint64_t>>(MAX_ENTRIES))
+	, m_num_entries(0)
+	, m_table_version(0)
+	, m_lock_table(false)
+	, m_thread_tables(nthreads)
+	, m_thread_table_versions(nthreads, 0)
+	, m_culled_entries(0)
+	, m_num_favored(0)
+{
+}
+
+Scheduler::~Scheduler() {
+	free_array(m_exec_cycles, MAX_ENTRIES);
+	free_array(m_size, MAX_ENTRIES);
+	free_array(m_instructions, MAX_ENTRIES);
+	free_array(m_times_selected, MAX_ENTRIES);
+	free_array(m_coverage_found, MAX_ENTRIES);
+	free_array(m_depth, MAX_ENTRIES);
+}
+
+bool Scheduler::parse_schedule(const string& name, Schedule& schedule) {
+	for (size_t i = 0; i < sizeof(schedule_str)/sizeof(*schedule_str); i++) {
+		if (name == schedule_str[i]) {
+			schedule = (Schedule)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t Scheduler::size() const {
+	return m_num_entries.load(memory_order_acquire);
+}
+
+void Scheduler::add_entry(size_t i, size_t size, const ExecInfo& exec_info,
+                          size_t depth, const vector<uint64_t>& coverage)
+{
+	ASSERT(i == m_num_entries, "bad entry %lu, expected %lu", i,
+	       m_num_entries.load());
+	ASSERT(i < MAX_ENTRIES, "too many entries: %lu", i);
+	m_exec_cycles[i].store(exec_info.cycles, memory_order_relaxed);
+	m_size[i].store(size, memory_order_relaxed);
+	m_instructions[i].store(exec_info.instructions, memory_order_relaxed);
+	m_times_selected[i].store(0, memory_order_relaxed);
+	m_coverage_found[i].store(0, memory_order_relaxed);
+	m_depth[i].store(depth, memory_order_relaxed);
+	m_coverages.push_back(coverage);
+	m_num_entries.store(i + 1, memory_order_release);
+}
+
+size_t Scheduler::depth(size_t i) const {
+	ASSERT(i < size(), "OOB i: %lu/%lu", i, size());
+	return m_depth[i].load(memory_order_relaxed);
+}
+
+size_t Scheduler::favored() const {
+	return m_num_favored;
+}
+
+void Scheduler::coverage_found(size_t i) {
+	ASSERT(i < size(), "OOB i: %lu/%lu", i, size());
+	m_coverage_found[i].fetch_add(1, memory_order_relaxed);
+}
+
+size_t Scheduler::choose(int id, Rng& rng) {
+	// Get the last table if ours is outdated
+	AliasTable& table = m_thread_tables[id];
+	if (m_thread_table_versions[id] != m_table_version.load()) {
+		while (m_lock_table.test_and_set());
+		table = m_table;
+		m_thread_table_versions[id] = m_table_version;
+		m_lock_table.clear();
+	}
+
+	// Entries that are not in the table yet are chosen half of the time
+	size_t i, n = size();
+	ASSERT(n > 0, "choosing from empty scheduler");
+	if (table.size() == 0) {
+		i = rng.rnd(0, n - 1);
+	} else if (n > table.size() && rng.rnd(0, 1)) {
+		i = rng.rnd(table.size(), n - 1);
+	} else {
+		i = rng.rnd(0, table.size() - 1);
+		if (rng.rnd() >= table.threshold[i])
+			i = table.alias[i];
+	}
+	m_times_selected[i].fetch_add(1, memory_order_relaxed);
+	return i;
+}
+
+double Scheduler::score(size_t i, double avg_cost, double avg_instr,
+                        double avg_size, double avg_selected) const
+{
+	uint64_t cycles   = m_exec_cycles[i].load(memory_order_relaxed);
+	uint64_t instr    = m_instructions[i].load(memory_order_relaxed);
+	uint64_t size     = m_size[i].load(memory_order_relaxed);
+	uint64_t selected = m_times_selected[i].load(memory_order_relaxed);
+	uint64_t found    = m_coverage_found[i].load(memory_order_relaxed);
+	uint64_t depth    = m_depth[i].load(memory_order_relaxed);
+
+	// Adjust score depending on how expensive the entry is compared to the
+	// average. Instruction counts are not noisy, but they don't account for
+	// vm exits, so we take the worst of both.
+	double ratio = (avg_cost ? cycles / avg_cost : 1);
+	if (avg_instr && instr)
+		ratio = max(ratio, instr / avg_instr);
+	double perf;
+	if      (ratio * 10 < 1) perf = 300;
+	else if (ratio * 4 < 1)  perf = 200;
+	else if (ratio * 2 < 1)  perf = 150;
+	else if (ratio > 10)     perf = 10;
+	else if (ratio > 4)      perf = 25;
+	else if (ratio > 2)      perf = 50;
+	else if (ratio > 1.33)   perf = 75;
+	else                     perf = 100;
+
+	// Big inputs take longer to mutate and reset, and are less likely to
+	// produce interesting mutations
+	if (avg_size && size > 4 * avg_size)
+		perf /= 2;
+
+	// Deeper entries are the result of more mutations, and they are more
+	// likely to reach code the others don't
+	if      (depth <= 3)  perf *= 1;
+	else if (depth <= 7)  perf *= 2;
+	else if (depth <= 13) perf *= 3;
+	else if (depth <= 25) perf *= 4;
+	else                  perf *= 5;
+
+	switch (m_schedule) {
+		case Schedule::Explore:
+			break;
+		case Schedule::Fast:
+			perf *= min(found + 1, (uint64_t)16);
+			perf /= 1 + log2(1 + selected);
+			break;
+		case Schedule::Rare:
+			perf *= (avg_selected + 1) / (selected + 1);
+			break;
+	}
+
+	perf = min(max(perf, (double)MIN_SCORE), (double)MAX_SCORE);
+	if (!m_favored[i])
+		perf /= NOT_FAVORED_PENALTY;
+	return perf;
+}
+
+bool Scheduler::cull(size_t n) {
+	if (m_culled_entries == n)
+		return false;
+
+	// Update top rated entries with the new ones
+	bool changed = false;
+	for (size_t i = m_culled_entries; i < n; i++) {
+		uint64_t cost = m_size[i].load(memory_order_relaxed) *
+		                m_exec_cycles[i].load(memory_order_relaxed);
+		for (uint64_t key : m_coverages[i]) {
+			auto it = m_top_rated.find(key);
+			if (it == m_top_rated.end()) {
+				m_top_rated[key] = i;
+				changed = true;
+			} else if (cost < m_size[it->second].load(memory_order_relaxed) *
+			                  m_exec_cycles[it->second].load(memory_order_relaxed)) {
+				it->second = i;
+				changed = true;
+			}
+		}
+	}
+	m_culled_entries = n;
+	m_favored.resize(n, false);
+	if (!changed)
+		return false;
+
+	// Greedily choose top rated entries until every key is covered
+	unordered_set<uint64_t> covered;
+	size_t num_favored = 0;
+	m_favored.assign(n, false);
+	for (const auto& key_entry : m_top_rated) {
+		if (covered.count(key_entry.first))
+			continue;
+		size_t i = key_entry.second;
+		if (!m_favored[i]) {
+			m_favored[i] = true;
+			num_favored++;
+		}
+		for (uint64_t key : m_coverages[i])
+			covered.insert(key);
+	}
+	m_num_favored = num_favored;
+	return true;
+}
+
+void Scheduler::update() {
+	size_t n = size();
+	if (n == 0)
+		return;
+	cull(n);
+
+	// Calculate averages
+	double avg_cost = 0, avg_instr = 0, avg_size = 0, avg_selected = 0;
+	for (size_t i = 0; i < n; i++) {
+		avg_cost     += m_exec_cycles[i].load(memory_order_relaxed);
+		avg_instr    += m_instructions[i].load(memory_order_relaxed);
+		avg_size     += m_size[i].load(memory_order_relaxed);
+		avg_selected += m_times_selected[i].load(memory_order_relaxed);
+	}
+	avg_cost     /= n;
+	avg_instr    /= n;
+	avg_size     /= n;
+	avg_selected /= n;
+
+	// Calculate scores and build the new table
+	m_scores.resize(n);
+	for (size_t i = 0; i < n; i++)
+		m_scores[i] = score(i, avg_cost, avg_instr, avg_size, avg_selected);
+	AliasTable table;
+	table.build(m_scores);
+
+	// Publish it
+	while (m_lock_table.test_and_set());
+	swap(m_table, table);
+	m_table_version++;
+	m_lock_table.clear();
+}
+
+size_t Scheduler::AliasTable::size() const {
+	return threshold.size();
+}
+
+void Scheduler::AliasTable::build(const vector<double>& scores) {
+	// Vose's alias method
+	size_t n = scores.size();
+	double total = 0;
+	for (double score : scores)
+		total += score;
+
+	vector<double> prob(n);
+	vector<uint32_t> small, large;
+	for (size_t i = 0; i < n; i++) {
+		prob[i] = scores[i] * n / total;
+		if (prob[i] < 1)
+			small.push_back(i);
+		else
+			large.push_back(i);
+	}
+
+	// Each small entry is paired with a large one, which fills the rest of
+	// its bucket
+	threshold.assign(n, UINT64_MAX);
+	alias.resize(n);
+	for (size_t i = 0; i < n; i++)
+		alias[i] = i;
+	while (!small.empty() && !large.empty()) {
+		uint32_t s = small.back(), l = large.back();
+		small.pop_back();
+		threshold[s] = ldexp(prob[s], 64);
+		alias[s] = l;
+		prob[l] -= 1 - prob[s];
+		if (prob[l] < 1) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// Remaining entries are the result of rounding errors and their
+	// probability is 1, as initialized
+}
@@ -0,0 +1,86 @@
+#include "snapshot_cache.h"
+
+using namespace std;
+
+SnapshotCache::SnapshotCache(size_t max_memsize)
+	: m_max_memsize(max_memsize)
+	, m_memsize(0)
+{
+}
+
+bool SnapshotCache::enabled() const {
+	return m_max_memsize != 0;
+}
+
+size_t SnapshotCache::size() const {
+	return m_snapshots.size();
+}
+
+size_t SnapshotCache::memsize() const {
+	return m_memsize;
+}
+
+const Snapshot* SnapshotCache::get(size_t i, const string& input) {
+	auto it = m_snapshots.find(i);
+	if (it == m_snapshots.end())
+		return nullptr;
+
+	// Mark it as most recently used only if it's valid for this input, so
+	// snapshots that keep missing are evicted first
+	Entry& entry = it->second;
+	if (!entry.snapshot.valid_for(input)) {
+		entry.misses++;
+		return nullptr;
+	}
+	entry.misses = 0;
+	m_lru.splice(m_lru.begin(), m_lru, entry.lru_it);
+	return &entry.snapshot;
+}
+
+bool SnapshotCache::wants_snapshot(size_t i) {
+	if (!enabled())
+		return false;
+	size_t& selections = m_selections[i];
+	selections++;
+	if (selections < HOT_THRESHOLD)
+		return false;
+
+	// Ask for a new snapshot if the current one keeps missing. Misses are
+	// reset so it's not asked again for every input if it can't be taken.
+	auto it = m_snapshots.find(i);
+	if (it == m_snapshots.end())
+		return true;
+	if (it->second.misses < MAX_MISSES)
+		return false;
+	it->second.misses = 0;
+	return true;
+}
+
+void SnapshotCache::insert(size_t i, Snapshot& snapshot) {
+	if (m_snapshots.count(i))
+		evict(i);
+
+	// Snapshots bigger than the whole cache are discarded
+	size_t snapshot_memsize = snapshot.memsize();
+	if (snapshot_memsize > m_max_memsize)
+		return;
+
+	// Make room for the new snapshot
+	while (m_memsize + snapshot_memsize > m_max_memsize)
+		evict(m_lru.back());
+
+	m_lru.push_front(i);
+	Entry& entry = m_snapshots[i];
+	swap(entry.snapshot, snapshot);
+	entry.lru_it = m_lru.begin();
+	entry.misses = 0;
+	m_memsize += snapshot_memsize;
+}
+
+void SnapshotCache::evict(size_t i) {
+	auto it = m_snapshots.find(i);
+	ASSERT(it != m_snapshots.end(), "evicting not existing snapshot %lu", i);
+	m_memsize -= it->second.snapshot.memsize();
+	m_lru.erase(it->second.lru_it);
+	m_snapshots.erase(it);
+}
@@ -0,0 +1,136 @@
+#include "stats_log.h"
+#include "corpus.h"
+#include "vm.h"
+#include "utils.h"
+
+using namespace std;
+
+// NaN isn't valid JSON, so idle workers get 0
+static double per_case(uint64_t n, uint64_t cases) {
+	return (cases ? (double)n / cases : 0);
+}
+
+StatsLog::StatsLog(const string& path, int nthreads)
+	: m_start(chrono::steady_clock::now())
+	, m_last_time(m_start)
+	, m_workers_old(nthreads)
+{
+	m_file = fopen(path.c_str(), "w");
+	ERROR_ON(!m_file, "opening stats log %s", path.c_str());
+}
+
+StatsLog::~StatsLog() {
+	fclose(m_file);
+}
+
+void StatsLog::write(const SharedStats& shared_stats, const Corpus& corpus) {
+	auto now = chrono::steady_clock::now();
+	double elapsed_total = chrono::duration<double>(now - m_start).count();
+	double elapsed = chrono::duration<double>(now - m_last_time).count();
+	m_last_time = now;
+
+	vector<Stats> workers;
+	for (int i = 0; i < shared_stats.nthreads(); i++)
+		workers.push_back(shared_stats.worker(i));
+	Stats total;
+	for (const Stats& stats : workers) {
+#define X(type, name) total.name += stats.name;
+		STATS_COUNTERS(X)
+#undef X
+#define X(name) total.name.add(stats.name);
+		STATS_HISTOGRAMS(X)
+#undef X
+		total.syscalls.add(stats.syscalls);
+	}
+
+	fprintf(m_file, "{\"time\": %.3f, \"corpus\": {\"size\": %lu, "
+	        "\"memsize\": %lu, \"cov\": %lu, \"favored\": %lu, "
+	        "\"unique_crashes\": %lu, \"crash_buckets\": %lu}",
+	        elapsed_total, corpus.size(), corpus.memsize(), corpus.coverage(),
+	        corpus.favored(), corpus.unique_crashes(), corpus.crash_buckets());
+
+	const char* sep = "";
+	fprintf(m_file, ", \"total\": {");
+#define X(type, name) \
+	fprintf(m_file, "%s\"" #name "\": %lu", sep, (uint64_t)total.name); \
+	sep = ", ";
+	STATS_COUNTERS(X)
+#undef X
+
+	// Histograms of the last interval
+	sep = "";
+	fprintf(m_file, "}, \"hist\": {");
+#define X(name) {                                                             \
+	Histogram hist = total.name;                                              \
+	hist.subtract(m_total_old.name);                                          \
+	fprintf(m_file, "%s\"" #name "\": {\"count\": %lu, \"p50\": %lu, "        \
+	        "\"p99\": %lu, \"p999\": %lu, \"max\": %lu}", sep, hist.count(),  \
+	        hist.percentile(0.5), hist.percentile(0.99),                      \
+	        hist.percentile(0.999), hist.max());                              \
+	sep = ", ";                                                               \
+}
+	STATS_HISTOGRAMS(X)
+#undef X
+
+	// Exits of the last interval, subtracted per worker
+	ExitProfile exits;
+	for (size_t i = 0; i < workers.size(); i++)
+		exits.add_interval(workers[i].exits, m_workers_old[i].exits);
+	sep = "";
+	fprintf(m_file, "}, \"exits\": {");
+	for (size_t i = 0; i < ExitProfile::MAX_EXIT_REASONS; i++) {
+		if (exits.exits(i)) {
+			fprintf(m_file, "%s\"%s\": {\"count\": %lu, \"cycles\": %lu}",
+			        sep, ExitProfile::exit_reason_str(i), exits.exits(i),
+			        exits.exit_cycles(i));
+			sep = ", ";
+		}
+	}
+	sep = "";
+	fprintf(m_file, "}, \"hypercalls\": {");
+	for (size_t i = 0; i < ExitProfile::MAX_HYPERCALLS; i++) {
+		if (exits.hypercalls(i)) {
+			fprintf(m_file, "%s\"%s\": {\"count\": %lu, \"cycles\": %lu}",
+			        sep, Vm::hypercall_str(i), exits.hypercalls(i),
+			        exits.hypercall_cycles(i));
+			sep = ", ";
+		}
+	}
+	sep = "";
+	fprintf(m_file, "}, \"debug_rips\": {");
+	for (const pair<uint64_t, uint64_t>& rip : exits.top_debug_rips(TOP_RIPS)) {
+		fprintf(m_file, "%s\"0x%lx\": %lu", sep, rip.first, rip.second);
+		sep = ", ";
+	}
+
+	// Syscalls of the last interval
+	SyscallProfile syscalls = total.syscalls;
+	syscalls.subtract(m_total_old.syscalls);
+	sep = "";
+	fprintf(m_file, "}, \"syscalls\": {");
+	for (size_t i = 0; i < SyscallProfile::MAX_SYSCALLS; i++) {
+		if (syscalls.counts[i]) {
+			fprintf(m_file, "%s\"%s\": {\"count\": %lu, \"cycles\": %lu}",
+			        sep, syscall_str(i), syscalls.counts[i],
+			        syscalls.cycles[i]);
+			sep = ", ";
+		}
+	}
+
+	fprintf(m_file, "}, \"workers\": [");
+	for (size_t i = 0; i < workers.size(); i++) {
+		const Stats& stats = workers[i];
+		const Stats& stats_old = m_workers_old[i];
+		uint64_t cases = stats.cases - stats_old.cases;
+		fprintf(m_file, "%s{\"cases\": %lu, \"fcps\": %.3f, "
+		        "\"reset_pages\": %.3f, \"vm_exits\": %.3f}",
+		        (i ? ", " : ""), stats.cases, cases / elapsed,
+		        per_case(stats.reset_pages - stats_old.reset_pages, cases),
+		        per_case(stats.vm_exits - stats_old.vm_exits, cases));
+	}
+	fprintf(m_file, "]}\n");
+	fflush(m_file);
+
+	m_total_old = total;
+	m_workers_old = move(workers);
+}
@@ -0,0 +1,60 @@
+#include "trimmer.h"
+
+using namespace std;
+
+Trimmer::Trimmer(const Vm& base, size_t max_input_size)
+	: m_base(base)
+	, m_vm(base)
+{
+	m_vm.set_breakpoints_dirty(true);
+	m_candidate.reserve(max_input_size);
+}
+
+Vm::RunEndReason Trimmer::run(const string& input) {
+	m_vm.reset_coverage();
+	m_vm.set_input(input);
+	Vm::RunEndReason reason = m_vm.run(m_stats);
+	m_vm.reset(m_base, m_stats);
+	return reason;
+}
+
+size_t Trimmer::trim(string& input, Coverage& cov, InputReadInfo& read_info) {
+	if (input.size() < MIN_INPUT_SIZE)
+		return 0;
+
+	// Get the full coverage of the input. If it doesn't exit normally, don't
+	// bother trimming it.
+	size_t runs = 1;
+	if (run(input) != Vm::RunEndReason::Exit)
+		return runs;
+	cov = m_vm.coverage();
+	read_info = m_vm.input_read_info();
+
+	// Start with chunks of 1/16 of the input, rounded to a power of two
+	size_t chunk_size = 1;
+	while (chunk_size * START_STEPS < input.size())
+		chunk_size *= 2;
+	size_t min_chunk_size = max(input.size() / END_STEPS, MIN_CHUNK_SIZE);
+
+	while (chunk_size >= min_chunk_size) {
+		size_t offset = 0;
+		while (offset < input.size()) {
+			// Remove the chunk at `offset` and check if coverage is the same
+			size_t len = min(chunk_size, input.size() - offset);
+			m_candidate.assign(input, 0, offset);
+			m_candidate.append(input, offset + len, string::npos);
+			runs++;
+			if (run(m_candidate) == Vm::RunEndReason::Exit &&
+			    m_vm.coverage() == cov)
+			{
+				// Keep the removal. Next chunk is now at `offset`
+				input.swap(m_candidate);
+				read_info = m_vm.input_read_info();
+			} else {
+				offset += chunk_size;
+			}
+		}
+		chunk_size /= 2;
+	}
+	return runs;
+}
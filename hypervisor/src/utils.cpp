@@ -31,9 +31,13 @@ string read_file(const string& filepath) {
 }
 
 void write_file(const string& filepath, const string& content) {
+	write_file(filepath, content.data(), content.size());
+}
+
+void write_file(const string& filepath, const char* data, size_t size) {
 	ofstream ofs(filepath);
 	ERROR_ON(!ofs.good(), "Error opening file %s for writing", filepath.c_str());
-	ofs << content;
+	ofs.write(data, size);
 	ERROR_ON(!ofs.good(), "Error writing to file %s", filepath.c_str());
 	ofs.close();
 }
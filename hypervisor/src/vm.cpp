@@ -11,6 +11,24 @@ using namespace std;
 int g_kvm_fd = -1;
 const char* Vm::reason_str[] = {"Exit", "Debug", "Crash", "Timeout", "Unknown"};
 
+// Same as the ones copied when creating a vm, except for the counting
+// performance counters. They are never reset, and the cost of each run is
+// computed from their values at its start and end.
+const vector<uint32_t> Vm::SNAPSHOT_MSRS = {
+	MSR_LSTAR,
+	MSR_STAR,
+	MSR_SYSCALL_MASK,
+	MSR_FS_BASE,
+	MSR_GS_BASE,
+	MSR_KERNEL_GS_BASE,
+	MSR_FIXED_CTR_CTRL,
+	MSR_PERF_GLOBAL_CTRL,
+	MSR_PERFEVTSEL0,
+	MSR_PERFEVTSEL1,
+	MSR_PERFEVTSEL2,
+	MSR_PMC2,
+};
+
 __attribute__((constructor))
 void init_kvm() {
 	g_kvm_fd = open("/dev/kvm", O_RDWR);
@@ -37,10 +55,16 @@ Vm::Vm(vsize_t mem_size, const string& kernel_path, const string& binary_path,
 	, m_mmu(m_vm_fd, m_vcpu_fd, mem_size)
 	, m_running(false)
 	, m_breakpoints_dirty(false)
-	, m_instructions_executed(0)
-	, m_instructions_executed_prev(0)
+	, m_input_read_info(InputReadInfo::whole(0))
+	, m_perf_counters{}
+	, m_perf_counters_prev{}
+	, m_run_start(0)
+	, m_sample_interval(0)
+	, m_samples_tail(0)
 	, m_timer_addr(0)
 	, m_timeout_addr(0)
+	, m_snapshot_offset_addr(0)
+	, m_snapshot_taken(false)
 {
 	load_elfs();
 	setup_kvm();
@@ -53,16 +77,23 @@ Vm::Vm(const Vm& other)
 	, m_elf(other.m_elf)
 	, m_kernel(other.m_kernel)
 	, m_interpreter(other.m_interpreter)
+	, m_libraries(other.m_libraries)
 	, m_argv(other.m_argv)
 	, m_mmu(m_vm_fd, m_vcpu_fd, other.m_mmu)
 	, m_running(false)
 	, m_breakpoints(other.m_breakpoints)
 	, m_breakpoints_dirty(other.m_breakpoints_dirty)
 	, m_file_contents(other.m_file_contents)
-	, m_instructions_executed(other.m_instructions_executed)
-	, m_instructions_executed_prev(other.m_instructions_executed_prev)
+	, m_input_read_info(other.m_input_read_info)
+	, m_perf_counters(other.m_perf_counters)
+	, m_perf_counters_prev(other.m_perf_counters_prev)
+	, m_run_start(0)
+	, m_sample_interval(other.m_sample_interval)
+	, m_samples_tail(0)
 	, m_timer_addr(other.m_timer_addr)
 	, m_timeout_addr(other.m_timeout_addr)
+	, m_snapshot_offset_addr(other.m_snapshot_offset_addr)
+	, m_snapshot_taken(false)
 	, m_allocations(other.m_allocations)
 {
 	// Elfs are already relocated by the other VM, we can init vmx pt
@@ -79,9 +110,9 @@ Vm::Vm(const Vm& other)
 	memcpy(m_sregs, other.m_sregs, sizeof(*m_sregs));
 
 	// Copy MSRs
-	size_t sz = sizeof(kvm_msrs) + sizeof(kvm_msr_entry)*8;
+	size_t sz = sizeof(kvm_msrs) + sizeof(kvm_msr_entry)*15;
 	kvm_msrs* msrs = (kvm_msrs*)alloca(sz);
-	msrs->nmsrs = 8;
+	msrs->nmsrs = 15;
 	msrs->entries[0].index = MSR_LSTAR;
 	msrs->entries[1].index = MSR_STAR;
 	msrs->entries[2].index = MSR_SYSCALL_MASK;
@@ -90,6 +121,13 @@ Vm::Vm(const Vm& other)
 	msrs->entries[5].index = MSR_FIXED_CTR_CTRL;
 	msrs->entries[6].index = MSR_PERF_GLOBAL_CTRL;
 	msrs->entries[7].index = MSR_FIXED_CTR0;
+	msrs->entries[8].index = MSR_FIXED_CTR1;
+	msrs->entries[9].index = MSR_PERFEVTSEL0;
+	msrs->entries[10].index = MSR_PERFEVTSEL1;
+	msrs->entries[11].index = MSR_PMC0;
+	msrs->entries[12].index = MSR_PMC1;
+	msrs->entries[13].index = MSR_PERFEVTSEL2;
+	msrs->entries[14].index = MSR_PMC2;
 	ioctl_chk(other.m_vcpu_fd, KVM_GET_MSRS, msrs);
 	ioctl_chk(m_vcpu_fd, KVM_SET_MSRS, msrs);
 
@@ -312,9 +350,9 @@ void Vm::set_sregs_dirty() {
 	m_vcpu_run->kvm_dirty_regs |= KVM_SYNC_X86_SREGS;
 }
 
-void Vm::set_instructions_executed(uint64_t instr_executed) {
-	m_instructions_executed_prev = m_instructions_executed;
-	m_instructions_executed = instr_executed;
+void Vm::set_perf_counters(const PerfCounters& counters) {
+	m_perf_counters_prev = m_perf_counters;
+	m_perf_counters = counters;
 }
 
 kvm_regs& Vm::regs() {
@@ -333,6 +371,43 @@ ElfParser& Vm::elf() {
 	return m_elf;
 }
 
+vector<const ElfParser*> Vm::elfs() const {
+	vector<const ElfParser*> elfs = {&m_kernel, &m_elf};
+	if (m_interpreter)
+		elfs.push_back(m_interpreter);
+	for (const ElfParser& library : m_libraries)
+		elfs.push_back(&library);
+	return elfs;
+}
+
+void Vm::load_libraries() {
+	if (!m_interpreter)
+		return;
+	vaddr_t r_debug = 0;
+	for (const symbol_t& symbol : m_interpreter->symbols())
+		if (symbol.name == "_r_debug")
+			r_debug = symbol.value;
+	if (!r_debug)
+		return;
+
+	// Walk the list of link_map, which starts at r_debug.r_map. Each one has
+	// the load bias and the name of an object, and the next one at offset 24.
+	// The binary and the vdso have no file, and the interpreter is already
+	// loaded.
+	m_libraries.clear();
+	vaddr_t link_map = m_mmu.read<vaddr_t>(r_debug + 8);
+	while (link_map) {
+		vaddr_t load_bias = m_mmu.read<vaddr_t>(link_map);
+		string name = m_mmu.read_string(m_mmu.read<vaddr_t>(link_map + 8));
+		link_map = m_mmu.read<vaddr_t>(link_map + 24);
+		if (name == m_interpreter->path() || !m_file_contents.count(name))
+			continue;
+		m_libraries.emplace_back(name);
+		m_libraries.back().set_base(load_bias);
+		dbgprintf("Library %s loaded at 0x%lx\n", name.c_str(), load_bias);
+	}
+}
+
 psize_t Vm::memsize() const {
 	return m_mmu.size();
 }
@@ -342,9 +417,49 @@ FaultInfo Vm::fault() const {
 }
 
 uint64_t Vm::instructions_executed_last_run() const {
+	return perf_counters_last_run().user_instructions;
+}
+
+PerfCounters Vm::perf_counters_last_run() const {
 	// Since we are not resetting guest MSRs, these counters are not resetted
 	// each run.
-	return m_instructions_executed - m_instructions_executed_prev;
+	return PerfCounters {
+		.user_instructions   = m_perf_counters.user_instructions -
+		                       m_perf_counters_prev.user_instructions,
+		.kernel_instructions = m_perf_counters.kernel_instructions -
+		                       m_perf_counters_prev.kernel_instructions,
+		.user_cycles         = m_perf_counters.user_cycles -
+		                       m_perf_counters_prev.user_cycles,
+		.kernel_cycles       = m_perf_counters.kernel_cycles -
+		                       m_perf_counters_prev.kernel_cycles,
+	};
+}
+
+const InputReadInfo& Vm::input_read_info() const {
+	return m_input_read_info;
+}
+
+const SyscallProfile& Vm::syscall_profile() const {
+	return m_mmu.shared_mem().syscalls;
+}
+
+void Vm::set_sample_interval(uint64_t cycles) {
+	ASSERT(cycles < (1ULL << 31), "sample interval too big: %lu", cycles);
+	m_sample_interval = cycles;
+}
+
+uint64_t Vm::pop_samples(vector<vaddr_t>& rips) {
+	// The guest overwrites the oldest samples when the ring is full
+	const SampleRing& ring = m_mmu.shared_mem().samples;
+	uint64_t head = ring.head;
+	uint64_t lost = 0;
+	if (head - m_samples_tail > SampleRing::SIZE) {
+		lost = head - m_samples_tail - SampleRing::SIZE;
+		m_samples_tail = head - SampleRing::SIZE;
+	}
+	for (; m_samples_tail < head; m_samples_tail++)
+		rips.push_back(ring.rips[m_samples_tail % SampleRing::SIZE]);
+	return lost;
 }
 
 const Coverage& Vm::coverage() const {
@@ -357,7 +472,9 @@ void Vm::reset_coverage() {
 
 void Vm::reset(const Vm& other, Stats& stats) {
 	// Reset mmu, regs and sregs
-	stats.reset_pages += m_mmu.reset(other.m_mmu);
+	size_t reset_pages = m_mmu.reset(other.m_mmu);
+	stats.reset_pages += reset_pages;
+	stats.reset_pages_hist.record(reset_pages);
 	memcpy(m_regs, other.m_regs, sizeof(*m_regs));
 	memcpy(m_sregs, other.m_sregs, sizeof(*m_sregs));
 
@@ -389,6 +506,7 @@ void Vm::reset(const Vm& other, Stats& stats) {
 	set_regs_dirty();
 	set_sregs_dirty();
 
+	m_snapshot_taken = false;
 	m_allocations = other.m_allocations;
 }
 
@@ -408,15 +526,66 @@ void Vm::set_input(const string& input) {
 	// m_regs->rsi = input_size;
 }
 
+size_t Snapshot::memsize() const {
+	return memory.size() + pages.size()*sizeof(paddr_t) + input_prefix.size() +
+	       xsave.size() + msrs.size()*sizeof(kvm_msr_entry) + sizeof(*this);
+}
+
+bool Snapshot::valid_for(const string& input) const {
+	return input.size() == input_size &&
+	       memcmp(input.c_str(), input_prefix.c_str(), input_prefix.size()) == 0;
+}
+
+void Vm::request_snapshot(size_t offset) {
+	if (!m_snapshot_offset_addr)
+		return;
+	ASSERT(!m_breakpoints_dirty, "snapshots with dirty breakpoints");
+	m_mmu.write<size_t>(m_snapshot_offset_addr, offset);
+}
+
+bool Vm::pop_snapshot(Snapshot& snapshot) {
+	if (!m_snapshot_taken)
+		return false;
+	swap(snapshot, m_snapshot);
+	m_snapshot_taken = false;
+	return true;
+}
+
+void Vm::restore_snapshot(const Snapshot& snapshot) {
+	m_mmu.restore_pages(snapshot.pages, snapshot.memory);
+	memcpy(m_regs, &snapshot.regs, sizeof(*m_regs));
+	memcpy(m_sregs, &snapshot.sregs, sizeof(*m_sregs));
+	set_regs_dirty();
+	set_sregs_dirty();
+
+	// Restore the state that isn't in the registers or in memory, so the run
+	// doesn't resume with the one the last run ended with
+	size_t n = snapshot.msrs.size();
+	kvm_msrs* msrs =
+		(kvm_msrs*)alloca(sizeof(kvm_msrs) + sizeof(kvm_msr_entry)*n);
+	msrs->nmsrs = n;
+	memcpy(msrs->entries, snapshot.msrs.data(), sizeof(kvm_msr_entry)*n);
+	ioctl_chk(m_vcpu_fd, KVM_SET_XSAVE, snapshot.xsave.data());
+	ioctl_chk(m_vcpu_fd, KVM_SET_MSRS, msrs);
+	ioctl_chk(m_vcpu_fd, KVM_SET_LAPIC, &snapshot.lapic);
+}
+
 Vm::RunEndReason Vm::run(Stats& stats) {
-	cycle_t cycles;
+	cycle_t cycles, exit_cycles, hc_cycles;
+	uint64_t hc;
 	RunEndReason reason = RunEndReason::Unknown;
 	m_running = true;
+	m_run_start = _rdtsc();
 
 	while (m_running) {
-		cycles = rdtsc2();
+		// Each exit is accounted the cycles of the KVM_RUN that caused it and
+		// the cycles of handling it
+		exit_cycles = rdtsc2();
 		ioctl_chk(m_vcpu_fd, KVM_RUN, 0);
-		stats.kvm_cycles += rdtsc2() - cycles;
+		cycles = rdtsc2() - exit_cycles;
+		stats.kvm_cycles += cycles;
+		if (TIMETRACE >= 2)
+			stats.kvm_cycles_hist.record(cycles);
 		stats.vm_exits++;
 		switch (m_vcpu_run->exit_reason) {
 			case KVM_EXIT_HLT:
@@ -428,10 +597,15 @@ Vm::RunEndReason Vm::run(Stats& stats) {
 					m_vcpu_run->io.port == 16)
 				{
 					// This will change `reason` in case it sets `m_running`
-					// to false
-					cycles = rdtsc2();
+					// to false. It also overwrites rax with the return value
+					hc = m_regs->rax;
+					hc_cycles = rdtsc2();
 					handle_hypercall(reason);
-					stats.hypercall_cycles += rdtsc2() - cycles;
+					hc_cycles = rdtsc2() - hc_cycles;
+					stats.hypercall_cycles += hc_cycles;
+					if (TIMETRACE >= 2)
+						stats.hypercall_cycles_hist.record(hc_cycles);
+					stats.exits.record_hypercall(hc, hc_cycles);
 					stats.vm_exits_hc++;
 				} else {
 					vm_err("IO");
@@ -446,6 +620,7 @@ Vm::RunEndReason Vm::run(Stats& stats) {
 				cout << endl;
 				break; */
 				stats.vm_exits_debug++;
+				stats.exits.record_debug(m_regs->rip);
 				if (m_breakpoints.count(m_regs->rip))
 					handle_breakpoint(reason);
 				else {
@@ -476,6 +651,8 @@ Vm::RunEndReason Vm::run(Stats& stats) {
 			default:
 				vm_err("UNKNOWN EXIT " + to_string(m_vcpu_run->exit_reason));
 		}
+		stats.exits.record_exit(m_vcpu_run->exit_reason,
+		                        rdtsc2() - exit_cycles);
 	}
 
 #ifdef ENABLE_COVERAGE_INTEL_PT
@@ -643,6 +820,7 @@ void Vm::update_coverage(Stats& stats) {
 
 		decoder_result_t ret = libxdc_decode(m_vmx_pt_decoder, m_vmx_pt, size);
 		ASSERT(ret == decoder_result_t::decoder_success, "libxdc decode: %d", ret);
+		m_coverage.invalidate_fingerprint();
 
 		// ofstream ofs("libtiff-trace");
 		// assert(ofs.good());
@@ -945,6 +1123,31 @@ void Vm::vm_err(const string& msg) {
 	die("%s\n", msg.c_str());
 }
 
+void Vm::write_symbol_maps(const string& path) const {
+	FILE* map = fopen((path + ".map").c_str(), "w");
+	FILE* kallsyms = fopen((path + ".kallsyms").c_str(), "w");
+	ERROR_ON(!map || !kallsyms, "opening symbol maps %s", path.c_str());
+
+	// Symbols are followed by their module, except the kernel ones, like in
+	// /proc/kallsyms
+	for (const ElfParser* elf : elfs()) {
+		string map_module, kallsyms_module;
+		if (elf != &m_kernel) {
+			map_module = " [" + elf->name() + "]";
+			kallsyms_module = "\t[" + elf->name() + "]";
+		}
+		for (const symbol_t& symbol : elf->function_symbols()) {
+			fprintf(map, "%lx %lx %s%s\n", symbol.value, symbol.size,
+			        symbol.name.c_str(), map_module.c_str());
+			fprintf(kallsyms, "%016lx %c %s%s\n", symbol.value,
+			        (symbol.binding == STB_LOCAL ? 't' : 'T'),
+			        symbol.name.c_str(), kallsyms_module.c_str());
+		}
+	}
+	fclose(map);
+	fclose(kallsyms);
+}
+
 void Vm::dump(const string& filename) {
 	m_mmu.dump_memory(m_mmu.size(), filename + ".dump");
 
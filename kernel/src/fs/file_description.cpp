@@ -80,6 +80,7 @@ FileDescription::FileDescription(uint32_t flags, const char* buf, size_t size)
 	, m_buf(buf)
 	, m_size(size)
 	, m_offset(0)
+	, m_is_input(false)
 { }
 
 void FileDescription::ref() {
@@ -136,6 +137,14 @@ void FileDescription::set_offset(size_t offset) {
 	m_offset = offset;
 }
 
+bool FileDescription::is_input() const {
+	return m_is_input;
+}
+
+void FileDescription::set_is_input(bool is_input) {
+	m_is_input = is_input;
+}
+
 size_t FileDescription::move_cursor(size_t increment) {
 	// Check if offset is currently past end
 	if (m_offset >= m_size)
@@ -152,15 +161,22 @@ size_t FileDescription::move_cursor(size_t increment) {
 
 // REGULAR FILE
 int FileDescription::stat(UserPtr<struct stat*> stat_ptr) const {
+	if (m_is_input)
+		FileManager::input_size_observed();
 	return stat_regular(stat_ptr, m_size, (inode_t)m_buf);
 }
 
 ssize_t FileDescription::read(UserPtr<void*> buf, size_t len) {
 	ASSERT(is_readable(), "trying to read from not readable file");
 
-	// Get cursor, move it, and try to write to memory the resulting length
+	// Get cursor, move it, and try to write to memory the resulting length.
+	// If we're reading from the input, let the FileManager know before the
+	// data gets to the user.
+	size_t offset = m_offset;
 	const char* p = cursor();
 	len = move_cursor(len);
+	if (m_is_input)
+		FileManager::input_read(offset, len);
 	return (copy_to_user(buf, p, len) ? len : -EFAULT);
 }
 
@@ -191,6 +207,7 @@ ssize_t FileDescriptionStdin::read(UserPtr<void*> buf, size_t len) {
 		m_input_opened = true;
 		struct iovec input = FileManager::file_content("input");
 		set_buf((const char*)input.iov_base, input.iov_len);
+		set_is_input(true);
 	}
 	return FileDescription::read(buf, len);
 }
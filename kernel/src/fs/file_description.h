@@ -36,6 +36,12 @@ public:
 	size_t offset() const;
 	void set_offset(size_t offset);
 
+	// Whether this file description reads from the input file. Reads from
+	// it are reported to the FileManager, which keeps track of how much of
+	// the input has been consumed.
+	bool is_input() const;
+	void set_is_input(bool is_input);
+
 	virtual bool is_socket() const { return false; }
 
 	// File operations
@@ -62,6 +68,9 @@ private:
 	// Cursor offset
 	size_t m_offset;
 
+	// Whether this file description reads from the input file
+	bool m_is_input;
+
 	// Attempt to move the cursor. Returns the real increment performed,
 	// emulating read or write
 	size_t move_cursor(size_t increment);
@@ -6,6 +6,17 @@ namespace FileManager {
 
 map<string, struct iovec> g_file_contents;
 
+// Parts of the input file that have been read
+InputReadInfo g_input_read_info;
+
+// Offset of the input byte before which we have to notify the hypervisor.
+// It is written by the hypervisor, and -1 means no snapshot is wanted.
+size_t g_snapshot_offset = (size_t)-1;
+
+// Whether the snapshot point was reached. It is set after the snapshot is
+// taken, so it's also set in runs resumed from it.
+bool g_snapshot_point_reached = false;
+
 void init(size_t num_files) {
 	// For each file, get its filename and its length and allocate a buffer
 	// for the file content. Submit the address of the buffer and the address of
@@ -23,6 +34,7 @@ void init(size_t num_files) {
 		iov.iov_len  = size;
 		hc_submit_file_pointers(i, iov.iov_base, &iov.iov_len);
 	}
+	hc_submit_snapshot_pointer(&g_snapshot_offset);
 
 	dbgprintf("Files: %d\n", g_file_contents.size());
 	for (auto v : g_file_contents) {
@@ -49,16 +61,19 @@ FileDescription* open(const string& pathname, int flags) {
 		(const char*)content.iov_base,
 		content.iov_len
 	);
+	description->set_is_input(pathname == "input");
 	return description;
 }
 
 FileDescriptionSocket* open_socket(SocketType type) {
 	struct iovec content = file_content("input");
-	return new FileDescriptionSocket(
+	FileDescriptionSocket* description = new FileDescriptionSocket(
 		(const char*)content.iov_base,
 		content.iov_len,
 		type
 	);
+	description->set_is_input(true);
+	return description;
 }
 
 FileDescription* open(SpecialFile file) {
@@ -75,6 +90,8 @@ FileDescription* open(SpecialFile file) {
 }
 
 int stat(const string& pathname, UserPtr<struct stat*> stat_ptr) {
+	if (pathname == "input")
+		input_size_observed();
 	struct iovec iov = file_content(pathname);
 	return FileDescription::stat_regular(
 		stat_ptr,
@@ -83,4 +100,75 @@ int stat(const string& pathname, UserPtr<struct stat*> stat_ptr) {
 	);
 }
 
+static void add_input_range(size_t start, size_t end) {
+	InputReadInfo& info = g_input_read_info;
+	if (start >= end)
+		return;
+
+	// Skip ranges that are before the new one, and merge the new one with
+	// every range it overlaps or is adjacent to
+	size_t i = 0, j;
+	while (i < info.num_ranges && info.ranges[i].end < start)
+		i++;
+	for (j = i; j < info.num_ranges && info.ranges[j].start <= end; j++) {
+		start = min(start, info.ranges[j].start);
+		end   = max(end, info.ranges[j].end);
+	}
+	if (j > i) {
+		// Ranges from i to j-1 have been merged into one
+		info.ranges[i] = { start, end };
+		size_t removed = j - i - 1;
+		for (j = i + 1; j + removed < info.num_ranges; j++)
+			info.ranges[j] = info.ranges[j + removed];
+		info.num_ranges -= removed;
+		return;
+	}
+
+	if (info.num_ranges == InputReadInfo::MAX_RANGES) {
+		// There's no room for the new range. Extend the closest one to
+		// include it, along with the gap between them.
+		bool extend_prev = (i == info.num_ranges) ||
+			(i > 0 && start - info.ranges[i-1].end < info.ranges[i].start - end);
+		if (extend_prev)
+			info.ranges[i-1].end = end;
+		else
+			info.ranges[i].start = start;
+		return;
+	}
+
+	// Insert it at position i
+	for (j = info.num_ranges; j > i; j--)
+		info.ranges[j] = info.ranges[j-1];
+	info.ranges[i] = { start, end };
+	info.num_ranges++;
+}
+
+void input_read(size_t offset, size_t len) {
+	// The input bytes before `max_offset` have already been read, so if this
+	// read goes past the snapshot offset, this is the first time that byte is
+	// going to be read. Notify the hypervisor just once.
+	InputReadInfo& info = g_input_read_info;
+	if (offset + len > g_snapshot_offset) {
+		g_snapshot_offset = (size_t)-1;
+		hc_snapshot_point(info.max_offset);
+		g_snapshot_point_reached = true;
+	}
+	info.max_offset = max(info.max_offset, offset + len);
+	add_input_range(offset, offset + len);
+}
+
+bool take_snapshot_point_reached() {
+	bool reached = g_snapshot_point_reached;
+	g_snapshot_point_reached = false;
+	return reached;
+}
+
+void input_size_observed() {
+	g_input_read_info.size_observed = true;
+}
+
+const InputReadInfo& input_read_info() {
+	return g_input_read_info;
+}
+
 }
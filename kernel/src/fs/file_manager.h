@@ -35,6 +35,23 @@ FileDescriptionSocket* open_socket(SocketType type);
 // Perform stat on a file. Used by syscall stat.
 int stat(const string& pathname, UserPtr<struct stat*> stat_ptr);
 
+// Report that `len` bytes of the input file are being read at `offset`, right
+// before they are made available to the user. If the hypervisor asked us to
+// stop before the input byte at the snapshot offset is read, this is where it
+// gets notified so it can take a snapshot.
+void input_read(size_t offset, size_t len);
+
+// Return whether the snapshot point was reached since the last call. Runs
+// resumed from a snapshot start right after it, in the middle of a syscall.
+bool take_snapshot_point_reached();
+
+// Report that the input size was observed without reading the whole input,
+// for example using stat or lseek
+void input_size_observed();
+
+// Information about the parts of the input that have been read so far
+const InputReadInfo& input_read_info();
+
 }
 
 #endif
\ No newline at end of file
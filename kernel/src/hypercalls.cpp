@@ -1,6 +1,7 @@
 #include "hypercalls.h"
 #include "x86/asm.h"
 #include "x86/perf/perf.h"
+#include "fs/file_manager.h"
 
 // Keep this the same as in the hypervisor!
 enum Hypercall : size_t {
@@ -15,6 +16,8 @@ enum Hypercall : size_t {
 	SubmitTimeoutPointers,
 	PrintStacktrace,
 	EndRun,
+	SubmitSnapshotPointer,
+	SnapshotPoint,
 };
 
 // This is traduced to:
@@ -108,10 +111,25 @@ void hc_print_stacktrace(uint64_t rsp, uint64_t rip, uint64_t rbp) {
 }
 
 __attribute__((naked))
-void _hc_end_run(RunEndReason reason, void* info, uint64_t instr_executed) {
+void _hc_end_run(RunEndReason reason, void* info, uint64_t instr_executed,
+                 EndRunInfo* end_run_info)
+{
 	hypercall(Hypercall::EndRun);
 }
 
 void hc_end_run(RunEndReason reason, void* info) {
-	_hc_end_run(reason, info, Perf::instructions_executed());
-}
\ No newline at end of file
+	static EndRunInfo end_run_info;
+	end_run_info.input_read = FileManager::input_read_info();
+	end_run_info.perf = Perf::counters();
+	_hc_end_run(reason, info, Perf::instructions_executed(), &end_run_info);
+}
+
+__attribute__((naked))
+void hc_submit_snapshot_pointer(size_t* snapshot_offset_ptr) {
+	hypercall(Hypercall::SubmitSnapshotPointer);
+}
+
+__attribute__((naked))
+void hc_snapshot_point(size_t input_consumed) {
+	hypercall(Hypercall::SnapshotPoint);
+}
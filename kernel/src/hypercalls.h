@@ -24,8 +24,13 @@ struct VmInfo {
 	void* elf_load_addr;
 	void* interp_base;
 	phinfo_t phinfo;
+	void* shared_mem;
+	uint64_t sample_interval;
 	struct termios2 term;
 };
+static_assert(sizeof(VmInfo) == 4240);
+static_assert(offsetof(VmInfo, shared_mem) == 4176);
+static_assert(offsetof(VmInfo, sample_interval) == 4184);
 
 // Keep this the same as in the hypervisor
 struct FaultInfo {
@@ -55,6 +60,68 @@ struct MemInfo {
 	void* physmap_vaddr;
 };
 
+// Keep this the same as in the hypervisor
+struct InputReadInfo {
+	static const size_t MAX_RANGES = 16;
+	struct Range {
+		size_t start;
+		size_t end;
+	};
+
+	// End of the furthest read performed on the input
+	size_t max_offset;
+
+	// Whether the input size was observed by other means than reading until
+	// the end of the input, such as stat or lseek
+	bool size_observed;
+
+	// Sorted disjoint ranges of the input that were read. If there were more
+	// than MAX_RANGES, some of them were merged with the gap between them.
+	size_t num_ranges;
+	Range ranges[MAX_RANGES];
+};
+
+// Count and cycles spent handling each syscall
+// Keep this the same as in the hypervisor
+struct SyscallProfile {
+	static const size_t MAX_SYSCALLS = 500;
+	uint64_t counts[MAX_SYSCALLS];
+	uint64_t cycles[MAX_SYSCALLS];
+};
+
+// Ring of sampled rips. Sample `i` is written to `rips[i % SIZE]`, and
+// `head` is the number of samples written
+// Keep this the same as in the hypervisor
+struct SampleRing {
+	static const size_t SIZE = 4096;
+	uint64_t head;
+	uint64_t rips[SIZE];
+};
+
+// Memory shared with the hypervisor, which isn't restored when the vm is
+// reset and doesn't count as dirty memory. Stats written to it accumulate
+// across runs.
+// Keep this the same as in the hypervisor
+struct SharedMem {
+	SyscallProfile syscalls;
+	SampleRing samples;
+};
+
+// Values of the performance counters, which are never reset
+// Keep this the same as in the hypervisor
+struct PerfCounters {
+	uint64_t user_instructions;
+	uint64_t kernel_instructions;
+	uint64_t user_cycles;
+	uint64_t kernel_cycles;
+};
+
+// Keep this the same as in the hypervisor
+struct EndRunInfo {
+	InputReadInfo input_read;
+	PerfCounters perf;
+};
+
 enum class RunEndReason {
 	Exit,
 	Debug,
@@ -77,5 +144,7 @@ void hc_submit_file_pointers(size_t n, void* buf, size_t* length_ptr);
 void hc_submit_timeout_pointers(size_t* timer_ptr, size_t* timeout_ptr);
 void hc_print_stacktrace(uint64_t rsp, uint64_t rip, uint64_t rbp);
 void hc_end_run(RunEndReason reason, void* info);
+void hc_submit_snapshot_pointer(size_t* snapshot_offset_ptr);
+void hc_snapshot_point(size_t input_consumed);
 
 #endif
\ No newline at end of file
@@ -97,4 +97,9 @@ void handle_apic_timer(InterruptFrame* frame) {
 	Perf::tick();
 
 	APIC::reset_timer();
+}
+
+__attribute__((interrupt))
+void handle_perf_sample(InterruptFrame* frame) {
+	Perf::sample(frame->rip);
 }
\ No newline at end of file
@@ -32,6 +32,7 @@ enum ExceptionNumber {
 
 enum IRQNumber {
 	APICTimer = 32,
+	PerfSample = 33,
 };
 
 struct InterruptFrame {
@@ -48,5 +49,6 @@ void handle_general_protection_fault(InterruptFrame* frame, uint64_t error_code)
 void handle_div_by_zero(InterruptFrame* frame);
 void handle_stack_segment_fault(InterruptFrame* frame, uint64_t error_code);
 void handle_apic_timer(InterruptFrame* frame);
+void handle_perf_sample(InterruptFrame* frame);
 
 #endif
\ No newline at end of file
@@ -25,8 +25,8 @@ extern "C" void kmain(int argc, char** argv) {
 	IDT::init();
 	PMM::init();
 	VMM::init();
-	Perf::init();
 	APIC::init();
+	Perf::init(info);
 	Syscall::init();
 	FileManager::init(info.num_files);
 
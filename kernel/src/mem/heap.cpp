@@ -2,8 +2,12 @@
 #include "vmm.h"
 #include "x86/page_table.h"
 
+const size_t Heap::SIZE_CLASSES[] = {16, 32, 64, 128, 256, 512, 1024};
+
 Heap::Heap()
-	: m_base(0)
+	: m_slabs{}
+	, m_free_pages(nullptr)
+	, m_base(0)
 	, m_used(0)
 	, m_size(0)
 {
@@ -31,20 +35,162 @@ size_t Heap::free_bytes() {
 	return m_size - m_used;
 }
 
-void* Heap::alloc(size_t size) {
-	ASSERT(m_base, "allocating on not initialized heap");
+size_t Heap::size_class(size_t size) {
+	for (size_t i = 0; i < NUM_SIZE_CLASSES; i++)
+		if (size <= SIZE_CLASSES[i])
+			return i;
+	return LARGE;
+}
 
-	if (size > free_bytes()) {
-		size_t n_pages = PAGE_CEIL(size - free_bytes()) / PAGE_SIZE;
-		ASSERT(more(n_pages), "OOM kernel heap");
+void Heap::list_push(PageHeader*& head, PageHeader* page) {
+	page->prev = nullptr;
+	page->next = head;
+	if (head)
+		head->prev = page;
+	head = page;
+}
+
+void Heap::list_remove(PageHeader*& head, PageHeader* page) {
+	if (page->prev)
+		page->prev->next = page->next;
+	else
+		head = page->next;
+	if (page->next)
+		page->next->prev = page->prev;
+}
+
+Heap::PageHeader* Heap::alloc_pages(size_t n_pages) {
+	// First fit in the free runs. If the run is bigger than needed, pages are
+	// taken from its end, so it stays in place in the list.
+	for (PageHeader* run = m_free_pages; run; run = run->next) {
+		if (run->n_pages < n_pages)
+			continue;
+		if (run->n_pages == n_pages) {
+			list_remove(m_free_pages, run);
+			return run;
+		}
+		run->n_pages -= n_pages;
+		PageHeader* pages = (PageHeader*)((uint8_t*)run + run->n_pages*PAGE_SIZE);
+		pages->n_pages = n_pages;
+		return pages;
 	}
 
-	void* ret = m_base + m_used;
+	// Take them from the end of the heap
+	size_t size = n_pages * PAGE_SIZE;
+	if (size > free_bytes()) {
+		size_t n_more = PAGE_CEIL(size - free_bytes()) / PAGE_SIZE;
+		ASSERT(more(n_more), "OOM kernel heap");
+	}
+	PageHeader* pages = (PageHeader*)(m_base + m_used);
+	pages->n_pages = n_pages;
 	m_used += size;
 	ASSERT(m_used <= m_size, "we fucked up: %p %p", m_used, m_size);
-	return ret;
+	return pages;
 }
 
-void Heap::free(void* ptr) {
+void Heap::free_pages(PageHeader* pages) {
+	// Insert the run in the list, sorted by address
+	PageHeader* prev = nullptr;
+	PageHeader* next = m_free_pages;
+	while (next && next < pages) {
+		prev = next;
+		next = next->next;
+	}
+	pages->prev = prev;
+	pages->next = next;
+	if (prev)
+		prev->next = pages;
+	else
+		m_free_pages = pages;
+	if (next)
+		next->prev = pages;
+
+	// Merge it with adjacent runs
+	if ((uint8_t*)pages + pages->n_pages*PAGE_SIZE == (uint8_t*)next) {
+		pages->n_pages += next->n_pages;
+		list_remove(m_free_pages, next);
+	}
+	if (prev && (uint8_t*)prev + prev->n_pages*PAGE_SIZE == (uint8_t*)pages) {
+		prev->n_pages += pages->n_pages;
+		list_remove(m_free_pages, pages);
+		pages = prev;
+	}
+
+	// Give the last run back to the end of the heap
+	if ((uint8_t*)pages + pages->n_pages*PAGE_SIZE == m_base + m_used) {
+		m_used -= pages->n_pages*PAGE_SIZE;
+		list_remove(m_free_pages, pages);
+	}
+}
+
+Heap::PageHeader* Heap::new_slab(size_t size_class) {
+	PageHeader* slab = alloc_pages(1);
+	slab->size_class = size_class;
+	slab->used = 0;
+
+	// Link every block of the slab
+	size_t block_size = SIZE_CLASSES[size_class];
+	uint8_t* block = (uint8_t*)(slab + 1);
+	uint8_t* end = (uint8_t*)slab + PAGE_SIZE;
+	Block** next = &slab->free_blocks;
+	for (; block + block_size <= end; block += block_size) {
+		*next = (Block*)block;
+		next = &((Block*)block)->next;
+	}
+	*next = nullptr;
+
+	list_push(m_slabs[size_class], slab);
+	return slab;
 }
 
+void* Heap::alloc(size_t size) {
+	ASSERT(m_base, "allocating on not initialized heap");
+
+	size_t i = size_class(size);
+	if (i == LARGE) {
+		size_t n_pages = PAGE_CEIL(size + sizeof(PageHeader)) / PAGE_SIZE;
+		PageHeader* pages = alloc_pages(n_pages);
+		pages->size_class = LARGE;
+		return pages + 1;
+	}
+
+	PageHeader* slab = m_slabs[i];
+	if (!slab)
+		slab = new_slab(i);
+	Block* block = slab->free_blocks;
+	slab->free_blocks = block->next;
+	slab->used++;
+
+	// Full slabs leave the list until one of their blocks is freed
+	if (!slab->free_blocks)
+		list_remove(m_slabs[i], slab);
+	return block;
+}
+
+void Heap::free(void* ptr) {
+	if (!ptr)
+		return;
+
+	PageHeader* page = (PageHeader*)((uintptr_t)ptr & PTL1_MASK);
+	if (page->size_class == LARGE) {
+		free_pages(page);
+		return;
+	}
+
+	size_t i = page->size_class;
+	ASSERT(i < NUM_SIZE_CLASSES && page->used, "bad free: %p", ptr);
+	if (!page->free_blocks)
+		list_push(m_slabs[i], page);
+	Block* block = (Block*)ptr;
+	block->next = page->free_blocks;
+	page->free_blocks = block;
+	page->used--;
+
+	// Give empty slabs back so any size class can reuse them, unless it's the
+	// only one of its class, so allocating and freeing a single object doesn't
+	// build a slab every time
+	if (!page->used && (page->prev || page->next)) {
+		list_remove(m_slabs[i], page);
+		free_pages(page);
+	}
+}
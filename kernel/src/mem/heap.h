@@ -3,6 +3,13 @@
 
 #include "common.h"
 
+// Kernel heap. Small allocations are served from slabs: pages split in blocks
+// of the same size class, each one with its own list of free blocks. Empty
+// slabs and pages of freed large allocations go to a list of free pages which
+// any size class can reuse, so allocating and freeing the same objects over
+// and over touches the same pages instead of new ones.
+// Every run of pages starts with a header, so `free` can find the size class
+// of a pointer from its page.
 class Heap {
 public:
 	Heap();
@@ -16,11 +23,46 @@ public:
 
 private:
 	static const size_t INITIAL_PAGES = 2;
-	bool more(size_t n_pages);
+	static const size_t NUM_SIZE_CLASSES = 7;
+	static const size_t SIZE_CLASSES[NUM_SIZE_CLASSES];
+
+	// Size class of allocations which take whole pages
+	static const size_t LARGE = NUM_SIZE_CLASSES;
+
+	struct Block {
+		Block* next;
+	};
+
+	// Header at the beginning of each run of pages. Slabs are one page long,
+	// and are linked in the list of their size class while they have free
+	// blocks. Free runs are linked in the list of free pages, sorted by
+	// address so adjacent runs can be merged.
+	struct alignas(16) PageHeader {
+		size_t size_class;
+		size_t n_pages;
+		size_t used;
+		Block* free_blocks;
+		PageHeader* prev;
+		PageHeader* next;
+	};
 
+	// Slabs with free blocks of each size class, and free runs of pages
+	PageHeader* m_slabs[NUM_SIZE_CLASSES];
+	PageHeader* m_free_pages;
+
+	// Pages that aren't in a free run are taken from the end of the heap
 	uint8_t* m_base;
 	size_t m_used;
 	size_t m_size;
+
+	bool more(size_t n_pages);
+	PageHeader* alloc_pages(size_t n_pages);
+	void free_pages(PageHeader* pages);
+	PageHeader* new_slab(size_t size_class);
+
+	static size_t size_class(size_t size);
+	static void list_push(PageHeader*& head, PageHeader* page);
+	static void list_remove(PageHeader*& head, PageHeader* page);
 };
 
-#endif
\ No newline at end of file
+#endif
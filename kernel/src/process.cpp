@@ -9,6 +9,7 @@ Process::Process(const VmInfo& info)
 	, m_elf_path(info.elf_path)
 	, m_brk(info.brk)
 	, m_min_brk(info.brk)
+	, m_shared_mem((SharedMem*)info.shared_mem)
 {
 	m_open_files[STDIN_FILENO] = FileManager::open(FileManager::Stdin);
 	m_open_files[STDOUT_FILENO] = FileManager::open(FileManager::Stdout);
@@ -29,25 +30,24 @@ int Process::available_fd() {
 
 const char* syscall_str[500];
 
-size_t syscall_counts[500];
-void print_syscalls() {
-	int sum = 0;
-	for (int i = 0; i < 500; i++) {
-		if (syscall_counts[i]) {
-			printf("%s: %d\n", syscall_str[i], syscall_counts[i]);
-			sum += syscall_counts[i];
-		}
-	}
-	printf("total: %d\n", sum);
-}
-
 uint64_t Process::handle_syscall(int nr, uint64_t arg0, uint64_t arg1,
                                  uint64_t arg2, uint64_t arg3,
 								 uint64_t arg4, uint64_t arg5, Regs* regs)
 {
 	dbgprintf("--> syscall at %p: %s\n", regs->rip, syscall_str[nr]);
 	m_user_regs = regs;
-	syscall_counts[nr]++;
+
+	// Syscalls are profiled in shared memory, so the hypervisor can read
+	// them without them dirtying memory. Exit doesn't return, so it's
+	// counted but its cycles aren't. Neither are the cycles of the syscall
+	// that reached the snapshot point, as runs resumed from the snapshot
+	// start in the middle of it.
+	SyscallProfile& profile = m_shared_mem->syscalls;
+	bool profiled = (size_t)nr < SyscallProfile::MAX_SYSCALLS;
+	uint64_t cycles = rdtsc();
+	if (profiled)
+		profile.counts[nr]++;
+
 	uint64_t ret = 0;
 	switch (nr) {
 		case SYS_openat:
@@ -90,7 +90,6 @@ uint64_t Process::handle_syscall(int nr, uint64_t arg0, uint64_t arg1,
 		case SYS_exit:
 		case SYS_exit_group:
 			//dbgprintf("end run --------------------------------\n\n");
-			//print_syscalls();
 			hc_end_run(RunEndReason::Exit, nullptr);
 			break;
 		case SYS_getuid:
@@ -232,6 +231,10 @@ uint64_t Process::handle_syscall(int nr, uint64_t arg0, uint64_t arg1,
 			die("Unimplemented syscall: %s (%lld)\n", syscall_str[nr], nr);
 	}
 
+	bool snapshot_point = FileManager::take_snapshot_point_reached();
+	if (profiled && !snapshot_point)
+		profile.cycles[nr] += rdtsc() - cycles;
+
 	dbgprintf("<-- syscall: %s returned 0x%lx\n", syscall_str[nr], ret);
 	return ret;
 }
\ No newline at end of file
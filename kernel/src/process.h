@@ -45,6 +45,7 @@ private:
 	uintptr_t m_brk;
 	uintptr_t m_min_brk;
 	Regs* m_user_regs;
+	SharedMem* m_shared_mem;
 
 	int available_fd();
 
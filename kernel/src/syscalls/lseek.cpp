@@ -1,5 +1,6 @@
 #include "process.h"
 #include "linux/fs.h"
+#include "fs/file_manager.h"
 
 off_t Process::do_sys_lseek(int fd, off_t offset, int whence) {
 	// We use signed types here, as the syscall does, but we use unsigned types
@@ -19,6 +20,8 @@ off_t Process::do_sys_lseek(int fd, off_t offset, int whence) {
 			break;
 
 		case SEEK_END:
+			if (file.is_input())
+				FileManager::input_size_observed();
 			ret = file.size() + offset;
 			break;
 
@@ -1,5 +1,6 @@
 #include "process.h"
 #include "linux/mman.h"
+#include "fs/file_manager.h"
 
 /* uint64_t prot_to_page_flags(int prot) {
 	ASSERT(!(prot & PROT_GROWSDOWN) && !(prot & PROT_GROWSUP), "prot: %d", prot);
@@ -156,7 +157,14 @@ uintptr_t Process::do_sys_mmap(UserPtr<void*> addr, size_t length, int prot,
 		// offset + length > f.size()). Let's see if offset > f.size() is
 		// supposed to be allowed.
 		ASSERT(offset <= f.size(), "offset OOB: %p / %p", offset, f.size());
-		memcpy(ret, f.buf() + offset, min(f.size() - offset, length));
+		size_t copy_length = min(f.size() - offset, length);
+		if (f.is_input()) {
+			// Mapping past the end of the input reveals its size
+			FileManager::input_read(offset, copy_length);
+			if (copy_length < length)
+				FileManager::input_size_observed();
+		}
+		memcpy(ret, f.buf() + offset, copy_length);
 
 		// If it was read only, remove write permissions after copying content
 		if (!(prot & PROT_WRITE)) {
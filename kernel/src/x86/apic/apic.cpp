@@ -97,7 +97,7 @@ void init() {
 	write_reg(Register::LogicalDestination,
 	          (read_reg(Register::LogicalDestination) & 0x00FFFFFF) | 1);
 	write_reg(Register::LvtTimer, APIC_DISABLE);
-	write_reg(Register::LvtPerformanceMonitoring, APIC_NMI);
+	write_reg(Register::LvtPerformanceMonitoring, IRQNumber::PerfSample);
 	write_reg(Register::LvtLINT0, APIC_DISABLE);
 	write_reg(Register::LvtLINT1, APIC_DISABLE);
 	write_reg(Register::TaskPriority, 0);
@@ -140,4 +140,11 @@ size_t timer_microsecs() {
 	return TIMER_MICROSECS;
 }
 
+void ack_perf_interrupt() {
+	// Delivering the interrupt masks the LVT entry, so unmask it and signal
+	// end of interrupt
+	write_reg(Register::LvtPerformanceMonitoring, IRQNumber::PerfSample);
+	write_reg(Register::EndOfInterrupt, 0);
+}
+
 }
\ No newline at end of file
@@ -7,6 +7,7 @@ namespace APIC {
 	void init();
 	void reset_timer();
 	size_t timer_microsecs();
+	void ack_perf_interrupt();
 }
 
 #endif
\ No newline at end of file
@@ -14,9 +14,17 @@
 #define MSR_GS_BASE          0xc0000101 // 64bit GS base
 #define MSR_KERNEL_GS_BASE   0xc0000102 // SwapGS GS shadow
 #define MSR_TSC_AUX          0xc0000103 // Auxiliary TSC
+#define MSR_PERFEVTSEL0      0x00000186
+#define MSR_PERFEVTSEL1      0x00000187
+#define MSR_PERFEVTSEL2      0x00000188
+#define MSR_PMC0             0x000000C1
+#define MSR_PMC1             0x000000C2
+#define MSR_PMC2             0x000000C3
 #define MSR_FIXED_CTR0       0x00000309
+#define MSR_FIXED_CTR1       0x0000030A
 #define MSR_FIXED_CTR_CTRL   0x0000038D
 #define MSR_PERF_GLOBAL_CTRL 0x0000038F
+#define MSR_PERF_GLOBAL_OVF_CTRL 0x00000390
 
 
 inline void wrmsr(unsigned int msr, uint64_t val) {
@@ -42,6 +50,16 @@ inline uint64_t rdmsr(unsigned int msr) {
 	return ((uint64_t)hi << 32) | lo;
 }
 
+inline uint64_t rdtsc() {
+	uint32_t hi, lo;
+	asm volatile(
+		"rdtsc"
+		: "=d" (hi),
+		  "=a" (lo)
+	);
+	return ((uint64_t)hi << 32) | lo;
+}
+
 inline uint64_t rdcr2() {
 	uint64_t val;
 	asm volatile(
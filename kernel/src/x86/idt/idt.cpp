@@ -42,6 +42,7 @@ void init() {
 		.set_offset((uint64_t)handle_general_protection_fault);
 	g_idt[ExceptionNumber::PageFault].set_offset((uint64_t)handle_page_fault);
 	g_idt[IRQNumber::APICTimer].set_offset((uint64_t)handle_apic_timer);
+	g_idt[IRQNumber::PerfSample].set_offset((uint64_t)handle_perf_sample);
 
 	// Load the IDT
 	IDTR idtr = {
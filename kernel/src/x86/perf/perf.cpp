@@ -9,21 +9,57 @@ enum CountMode {
 	User = 2,
 };
 
+// Fields of MSR_PERFEVTSELx
+enum EventSelect : uint64_t {
+	InstructionsRetired = 0xC0,
+	UnhaltedCoreCycles  = 0x3C,
+	USR                 = 1 << 16,
+	OS                  = 1 << 17,
+	INT                 = 1 << 20,
+	Enable              = 1 << 22,
+};
+
 // Hypervisor will write to these
 // this may be resetted after each run?
 static size_t g_timer = 0;
 static size_t g_timeout_microsecs = -1;
 
-void init() {
+// Rips are sampled every g_sample_interval cycles into the ring, which is in
+// memory shared with the hypervisor. 0 means sampling is disabled.
+static uint64_t g_sample_interval = 0;
+static SampleRing* g_samples = nullptr;
+
+void init(const VmInfo& info) {
+	uint64_t global_ctrl = 0;
 #ifdef ENABLE_INSTRUCTION_COUNT
-	// Set perfomance counter CTR0 (which counts number of instructions)
-	// to only count when in user mode
-	wrmsr(MSR_FIXED_CTR_CTRL, CountMode::User);
+	// Set fixed perfomance counters CTR0 (which counts number of
+	// instructions) and CTR1 (which counts unhalted cycles) to only count
+	// when in user mode. Fixed counters count either rings or both, so kernel
+	// instructions and cycles are counted with general purpose counters.
+	wrmsr(MSR_FIXED_CTR_CTRL, CountMode::User | (CountMode::User << 4));
+	wrmsr(MSR_PERFEVTSEL0, EventSelect::InstructionsRetired |
+	                       EventSelect::OS | EventSelect::Enable);
+	wrmsr(MSR_PERFEVTSEL1, EventSelect::UnhaltedCoreCycles |
+	                       EventSelect::OS | EventSelect::Enable);
 
-	// Enable CTR0
-	wrmsr(MSR_PERF_GLOBAL_CTRL, 1ULL << 32);
+	// Enable CTR0, CTR1, PMC0 and PMC1
+	global_ctrl |= (1ULL << 32) | (1ULL << 33) | (1 << 0) | (1 << 1);
 #endif
 
+	// PMC2 counts cycles in both rings starting at -interval, and raises an
+	// interrupt when it overflows. Writes to PMCs are sign extended from 32
+	// bits, so the interval must be lower than 2^31.
+	g_sample_interval = info.sample_interval;
+	if (g_sample_interval) {
+		g_samples = &((SharedMem*)info.shared_mem)->samples;
+		wrmsr(MSR_PERFEVTSEL2, EventSelect::UnhaltedCoreCycles |
+		                       EventSelect::USR | EventSelect::OS |
+		                       EventSelect::INT | EventSelect::Enable);
+		wrmsr(MSR_PMC2, -g_sample_interval);
+		global_ctrl |= (1 << 2);
+	}
+	wrmsr(MSR_PERF_GLOBAL_CTRL, global_ctrl);
+
 	hc_submit_timeout_pointers(&g_timer, &g_timeout_microsecs);
 
 	dbgprintf("Perf initialized\n");
@@ -37,6 +73,19 @@ size_t instructions_executed() {
 #endif
 }
 
+PerfCounters counters() {
+	PerfCounters counters;
+#ifdef ENABLE_INSTRUCTION_COUNT
+	counters.user_instructions   = rdmsr(MSR_FIXED_CTR0);
+	counters.kernel_instructions = rdmsr(MSR_PMC0);
+	counters.user_cycles         = rdmsr(MSR_FIXED_CTR1);
+	counters.kernel_cycles       = rdmsr(MSR_PMC1);
+#else
+	counters = {};
+#endif
+	return counters;
+}
+
 void tick() {
 	g_timer += APIC::timer_microsecs();
 	if (g_timer >= g_timeout_microsecs) {
@@ -48,4 +97,14 @@ void tick() {
 	}
 }
 
+void sample(uint64_t rip) {
+	g_samples->rips[g_samples->head % SampleRing::SIZE] = rip;
+	g_samples->head++;
+
+	// Rearm the counter and clear its overflow bit
+	wrmsr(MSR_PMC2, -g_sample_interval);
+	wrmsr(MSR_PERF_GLOBAL_OVF_CTRL, 1 << 2);
+	APIC::ack_perf_interrupt();
+}
+
 }
\ No newline at end of file
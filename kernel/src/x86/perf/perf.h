@@ -5,9 +5,11 @@
 
 namespace Perf {
 
-void init();
+void init(const VmInfo& info);
 size_t instructions_executed();
+PerfCounters counters();
 void tick();
+void sample(uint64_t rip);
 
 }
 
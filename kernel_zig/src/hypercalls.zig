@@ -36,9 +36,32 @@ pub const VmInfo = extern struct {
     elf_load_addr: usize,
     interp_base: usize,
     phinfo: phinfo_t,
-    term: linux.termios,
+    shared_mem: usize,
+    sample_interval: u64,
+    term: termios2,
 };
 
+// Keep this the same as struct termios2 in the hypervisor
+const termios2 = extern struct {
+    iflag: u32,
+    oflag: u32,
+    cflag: u32,
+    lflag: u32,
+    line: u8,
+    cc: [19]u8,
+    ispeed: u32,
+    ospeed: u32,
+};
+
+comptime {
+    if (@sizeOf(VmInfo) != 4240 or
+        @byteOffsetOf(VmInfo, "shared_mem") != 4176 or
+        @byteOffsetOf(VmInfo, "sample_interval") != 4184)
+    {
+        @compileError("VmInfo layout changed");
+    }
+}
+
 // Keep this the same as in the hypervisor
 pub const MemInfo = extern struct {
     mem_start: usize,
@@ -171,7 +194,7 @@ pub extern fn getFileLen(n: usize) usize;
 pub extern fn getFileName(n: usize, buf: [*]u8) void;
 pub extern fn submitFilePointers(n: usize, buf: [*]u8, length_ptr: *usize) void;
 pub extern fn submitTimeoutPointers(timer_ptr: *usize, timeout_ptr: *usize) void;
-extern fn _endRun(reason: RunEndReason, info: ?*const FaultInfo, instr_executed: usize) noreturn;
+extern fn _endRun(reason: RunEndReason, info: ?*const FaultInfo, instr_executed: usize, end_run_info: ?*const anyopaque) noreturn;
 
 pub fn print(s: []const u8) void {
     for (s) |c| {
@@ -183,7 +206,8 @@ const pmm = @import("mem/mem.zig").pmm;
 const log = @import("log.zig");
 pub fn endRun(reason: RunEndReason, info: ?*const FaultInfo) noreturn {
     // log.print("frames allocated: {}\n", .{pmm.numberOfAllocations()});
-    _endRun(reason, info, x86.perf.instructionsExecuted());
+    // We don't provide an EndRunInfo yet
+    _endRun(reason, info, x86.perf.instructionsExecuted(), null);
 }
 
 const buf_len = 1024;
@@ -0,0 +1,31 @@
+#!/usr/bin/env python3
+import json
+import sys
+
+# Print fields of the stats.jsonl written by kvm-fuzz as columns, for gnuplot.
+# Fields are paths like corpus.cov or hist.run_cycles_hist.p99. A path into
+# workers, like workers.fcps, gives a column for each worker.
+def get(obj, path):
+	for key in path:
+		obj = obj[key]
+	return obj
+
+def main():
+	if len(sys.argv) < 3:
+		print("usage: %s stats.jsonl field [field ...]" % sys.argv[0])
+		sys.exit(-1)
+
+	fields = [field.split(".") for field in sys.argv[2:]]
+	with open(sys.argv[1]) as f:
+		for line in f:
+			stats = json.loads(line)
+			columns = [stats["time"]]
+			for field in fields:
+				if field[0] == "workers":
+					columns += [get(worker, field[1:]) for worker in stats["workers"]]
+				else:
+					columns.append(get(stats, field))
+			print(" ".join(str(column) for column in columns))
+
+if __name__ == "__main__":
+	main()
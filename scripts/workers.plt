@@ -0,0 +1,9 @@
+#!/usr/bin/env -S gnuplot -p
+# Per-worker fuzz cases per second, from the stats.jsonl in the output folder
+set grid
+set title "Fuzz cases per second of each worker vs time"
+set ylabel "Fuzz cases per second"
+set xlabel "Time (seconds)"
+data = "< ".system("dirname ".ARG0)."/stats_columns.py ./out/stats.jsonl workers.fcps"
+stats data nooutput
+plot for [i=2:STATS_columns] data using 1:i with lines title sprintf("worker %d", i-2)